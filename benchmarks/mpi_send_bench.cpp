@@ -1,10 +1,73 @@
 #include <ratio>
 #include <mpi.h>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <thread>
 
 using namespace std;
 
+/* Slot in a shared window, published by setting the generation after the value */
+struct Slot {
+    double value;
+    uint64_t generation;
+};
+
+static double shared_roundtrip(const int c_rank, const long int iterations) {
+    MPI_Comm nodeComm;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &nodeComm);
+
+    int nodeSize;
+    MPI_Comm_size(nodeComm, &nodeSize);
+    if (nodeSize < 2 || c_rank > 1) {
+        MPI_Comm_free(&nodeComm);
+        return -1.0;
+    }
+
+    Slot *ownSlot, *peerSlot;
+    MPI_Win window;
+    MPI_Win_allocate_shared(sizeof(Slot), sizeof(Slot), MPI_INFO_NULL, nodeComm, &ownSlot, &window);
+    *ownSlot = Slot { 0.0, 0 };
+
+    MPI_Aint size;
+    int displacementUnit;
+    MPI_Win_shared_query(window, 1 - c_rank, &size, &displacementUnit, &peerSlot);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, window);
+    MPI_Barrier(nodeComm);
+
+    auto publish = [] (Slot *slot, const double value, const uint64_t generation) {
+        slot->value = value;
+        std::atomic_ref<uint64_t>(slot->generation).store(generation, std::memory_order_release);
+    };
+    auto await = [] (Slot *slot, const uint64_t generation) {
+        while (std::atomic_ref<uint64_t>(slot->generation).load(std::memory_order_acquire) != generation) {
+            std::this_thread::yield();
+        }
+        return slot->value;
+    };
+
+    auto t1 = chrono::high_resolution_clock::now();
+    double num = 2.0;
+    for (long int i = 1; i <= iterations; i++) {
+        if (c_rank == 0) {
+            publish(peerSlot, num + 1.0, i);
+            num = await(ownSlot, i);
+        } else {
+            num = await(ownSlot, i);
+            publish(peerSlot, num, i);
+        }
+    }
+    auto t2 = chrono::high_resolution_clock::now();
+
+    MPI_Win_unlock_all(window);
+    MPI_Win_free(&window);
+    MPI_Comm_free(&nodeComm);
+
+    chrono::duration<double, nano> dur = t2 - t1;
+    return dur.count() / (double) iterations;
+}
+
 int main(int argc, char **argv) {
     int c_rank;
     MPI_Init(&argc, &argv);
@@ -36,7 +99,34 @@ int main(int argc, char **argv) {
     double avg = dur.count() / (double) iterations;
     cout << "MPI_Send&Recv took on average " << avg << "ns" << endl;
 
+    // Latency of handing a value over and back, as a tree reduction does between neighbouring ranks
+    MPI_Barrier(MPI_COMM_WORLD);
+    t1 = chrono::high_resolution_clock::now();
+    for (auto i = 0; i < iterations; i++) {
+        if (c_rank == 0) {
+            num += 1.0;
+            MPI_Send(&num, 1, MPI_DOUBLE, 1, 0, MPI_COMM_WORLD);
+            MPI_Recv(&num, 1, MPI_DOUBLE, 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        } else if(c_rank == 1) {
+            MPI_Recv(&num, 1, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            MPI_Send(&num, 1, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);
+        }
+    }
+    t2 = chrono::high_resolution_clock::now();
+
+    dur = t2 - t1;
+    avg = dur.count() / (double) iterations;
+    if (c_rank == 0) cout << "MPI_Send&Recv round trip took on average " << avg << "ns" << endl;
 
+    MPI_Barrier(MPI_COMM_WORLD);
+    avg = shared_roundtrip(c_rank, iterations);
+    if (c_rank == 0) {
+        if (avg < 0.0) {
+            cout << "Shared window round trip skipped, ranks 0 and 1 are not on the same node" << endl;
+        } else {
+            cout << "Shared window round trip took on average " << avg << "ns" << endl;
+        }
+    }
 
     MPI_Finalize();
 }
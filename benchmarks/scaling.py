@@ -7,6 +7,7 @@ import platform
 import zipfile
 import subprocess
 import glob
+import itertools
 from benchmark import grep_number, init_db
 
 def get_n(datafile):
@@ -32,6 +33,12 @@ if __name__ == '__main__':
     parser.add_argument("--max", type=int, default=os.cpu_count(), help="Maximum number of ranks")
     parser.add_argument("--scorep", action="store_true", help="Collect ScoreP metrics")
     parser.add_argument("--modes", type=str, help="computation modes", default="tree")
+    parser.add_argument("--threads", type=str, default="1",
+            help="Comma-separated threads per rank, the core count is split into ranks * threads")
+    parser.add_argument("--transports", type=str, default="isend",
+            help="Comma-separated transports of tree mode, e.g. isend,persistent,shared,rma")
+    parser.add_argument("--progress", type=str, default="off",
+            help="Comma-separated on/off, whether tree mode communicates from a progress thread")
     parser.add_argument("--cluster-mode", help="For use on cluster with SLURM workload manager", action='store_true')
 
     args = parser.parse_args()
@@ -45,6 +52,9 @@ if __name__ == '__main__':
     n_cutoff = args.n
     scorep = args.scorep
     modes = args.modes.split(",")
+    thread_counts = [int(t) for t in args.threads.split(",")]
+    transports = args.transports.split(",")
+    progress_modes = args.progress.split(",")
     cluster_mode = args.cluster_mode
 
 
@@ -92,20 +102,35 @@ if __name__ == '__main__':
         ms[0] = 1
 
     for mode in modes:
-        for m in ms:
+        for m, threads, transport, progress in itertools.product(ms, thread_counts, transports, progress_modes):
+            # m is the number of cores, which are shared by m / threads ranks
+            if m % threads != 0:
+                continue
+            ranks = m // threads
+            layout = mode if threads == 1 else f"{mode},threads={threads}"
+            if transport != "isend":
+                layout += f",transport={transport}"
+            if progress == "on":
+                layout += ",progress"
+
             n = int(min(n_datafile, n_cutoff))
             if weak:
                 n = m * int(n / max(ms))
-            print(f"n={n}, m={m}")
+            print(f"n={n}, m={m}, threads={threads}, transport={transport}, progress={progress}")
 
             cluster_opts = "--bind-to core --map-by core -report-bindings" if cluster_mode else ""
-            opts = f"--use-hwthread-cpus -np {m} {cluster_opts}"
+            if cluster_mode and threads > 1:
+                cluster_opts = f"--bind-to core --map-by slot:PE={threads} -report-bindings"
+            opts = f"--use-hwthread-cpus -np {ranks} {cluster_opts}"
             repetitions = "100"
-            flags = f"-n {n}"
+            flags = f"-n {n} --threads {threads} --transport {transport}"
+            if progress == "on":
+                flags += " --progress-thread"
             cmd = f"mpirun {opts} {executable} -f {datafile} --{mode} -r {repetitions} {flags} 2>&1"
             print(f"\t{cmd}")
             env = dict(os.environ)
-            scorep_dir = f"scorep_run={run_id}_n={n}_m={m}"
+            env["OMP_PROC_BIND"] = "close"
+            scorep_dir = f"scorep_run={run_id}_n={n}_m={m}_t={threads}"
             env["SCOREP_EXPERIMENT_DIRECTORY"] = scorep_dir
             r = subprocess.run(cmd, env=env, shell=True, capture_output=True)
             r.check_returncode()
@@ -117,7 +142,7 @@ if __name__ == '__main__':
 
             cur.execute('INSERT INTO results(run_id, datafile, n_summands, repetitions, mode, time_ns, stddev, output, ranks)' \
                     'VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)',
-                    (run_id, datafile, n, repetitions, mode, time, stddev, output, m))
+                    (run_id, datafile, n, repetitions, layout, time, stddev, output, ranks))
             con.commit()
 
             result_id = cur.execute("SELECT MAX(id) FROM results").fetchall()[0][0]
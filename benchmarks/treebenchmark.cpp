@@ -1,4 +1,6 @@
 #include "strategies/binary_tree.hpp"
+#include "strategies/multi_column_tree.hpp"
+#include "strategies/progress_thread.hpp"
 #include "distribution.hpp"
 #include <benchmark/benchmark.h>
 #include <vector>
@@ -83,6 +85,173 @@ static void BM_iterative(benchmark::State& state) {
 }
 BENCHMARK(BM_iterative)->RangeMultiplier(8)->Range(1, 1 << 27)->Iterations(1);
 
+static void BM_planReplay(benchmark::State& state) {
+    const int n = state.range(0);
+
+    // Prepare input data
+    vector<double> data;
+    data.reserve(n);
+    for(int i = 0; i < n; i++) data.push_back(i);
+
+    vector<int> n_summands = {n};
+    BinaryTreeSummation tree(0, n_summands);
+    tree.distribute(data);
+
+    for (auto _ : state) {
+       volatile double a = tree.replayPlan();
+    }
+}
+BENCHMARK(BM_planReplay)->RangeMultiplier(8)->Range(1, 1 << 27)->Iterations(1);
+
+static void BM_planReplayThreads(benchmark::State& state) {
+    const int n = 1 << 26;
+
+    // Prepare input data
+    vector<double> data;
+    data.reserve(n);
+    for(int i = 0; i < n; i++) data.push_back(i);
+
+    vector<int> n_summands = {n};
+    BinaryTreeSummation tree(0, n_summands);
+    tree.distribute(data);
+    tree.setThreads(state.range(0));
+
+    for (auto _ : state) {
+       volatile double a = tree.replayPlan();
+    }
+}
+BENCHMARK(BM_planReplayThreads)->RangeMultiplier(2)->Range(1, 16)->Iterations(1);
+
+/* Single local block of 2^level summands, the work between two flushes of the plan. Compare with
+ * BM_progressHandoff for the smallest block that is worth handing the communication off for */
+static void BM_blockReplay(benchmark::State& state) {
+    const int n = 1 << state.range(0);
+
+    // Prepare input data
+    vector<double> data;
+    data.reserve(n);
+    for(int i = 0; i < n; i++) data.push_back(i);
+
+    vector<int> n_summands = {n};
+    BinaryTreeSummation tree(0, n_summands);
+    tree.distribute(data);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tree.replayPlan());
+    }
+}
+BENCHMARK(BM_blockReplay)->DenseRange(10, 18, 2);
+
+/* Fork and join of the parallel loop in accumulate_block without any work, compare with
+ * BM_blockReplay for the smallest block that is worth splitting among threads */
+static void BM_parallelRegion(benchmark::State& state) {
+    const int threads = state.range(0);
+    vector<double> chunkValues(4 * threads);
+
+    for (auto _ : state) {
+        #pragma omp parallel for num_threads(threads) schedule(dynamic)
+        for (int c = 0; c < 4 * threads; c++) {
+            chunkValues[c] = c;
+        }
+        benchmark::DoNotOptimize(chunkValues.data());
+    }
+}
+BENCHMARK(BM_parallelRegion)->RangeMultiplier(2)->Range(1, 4);
+
+/* One handOff and reclaim around a block, with a progress step as cheap as an idle receiveAvailable */
+static void BM_progressHandoff(benchmark::State& state) {
+    ProgressThread progress([] () {});
+
+    for (auto _ : state) {
+        progress.handOff();
+        progress.reclaim();
+    }
+}
+BENCHMARK(BM_progressHandoff);
+
+static void BM_planReplayKernel(benchmark::State& state) {
+    const KernelVariant variant = static_cast<KernelVariant>(state.range(0));
+    const int n = state.range(1);
+
+    if (!TreeKernels::supported(variant)) {
+        state.SkipWithError("Kernel not supported by this CPU");
+        return;
+    }
+
+    // Prepare input data
+    vector<double> data;
+    data.reserve(n);
+    for(int i = 0; i < n; i++) data.push_back(i);
+
+    vector<int> n_summands = {n};
+    BinaryTreeSummation tree(0, n_summands);
+    tree.distribute(data);
+    tree.setKernel(variant);
+    state.SetLabel(tree.getKernel().name);
+
+    for (auto _ : state) {
+       volatile double a = tree.replayPlan();
+    }
+}
+BENCHMARK(BM_planReplayKernel)->ArgsProduct({
+        {static_cast<int>(KernelVariant::SCALAR), static_cast<int>(KernelVariant::AVX2),
+         static_cast<int>(KernelVariant::AVX512)},
+        {1 << 12, 1 << 18, 1 << 24}});
+
+/* K columns along one tree, compare with K times BM_planReplay of n / K summands */
+static void BM_multiColumnReplay(benchmark::State& state) {
+    const int columns = state.range(0);
+    const int n = (1 << 24) / columns;
+
+    // Prepare input data
+    vector<double> data;
+    data.reserve(static_cast<size_t>(n) * columns);
+    for(size_t i = 0; i < static_cast<size_t>(n) * columns; i++) data.push_back(i);
+
+    vector<int> n_summands = {n};
+    MultiColumnTreeSummation tree(0, n_summands, columns);
+    tree.distribute(data);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tree.replayPlan());
+    }
+}
+BENCHMARK(BM_multiColumnReplay)->RangeMultiplier(2)->Range(1, 16);
+
+/* Same tree as BM_planReplay with other operators, compare with the tuned sum */
+template <typename Operator>
+static void BM_operatorReplay(benchmark::State& state) {
+    const int n = state.range(0);
+
+    // Prepare input data
+    vector<double> data;
+    data.reserve(n);
+    for(int i = 0; i < n; i++) data.push_back(-static_cast<double>(i % 1000));
+
+    vector<int> n_summands = {n};
+    TreeReduction<Operator> tree(0, n_summands);
+    tree.distribute(data);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tree.replayPlan());
+    }
+}
+BENCHMARK(BM_operatorReplay<SumOperator>)->Arg(1 << 24);
+BENCHMARK(BM_operatorReplay<MaxOperator>)->Arg(1 << 24);
+BENCHMARK(BM_operatorReplay<LogSumExpOperator>)->Arg(1 << 24);
+
+/* One-time cost of building the plan for a rank in the middle of the cluster */
+static void BM_planConstruction(benchmark::State& state) {
+    const int m = state.range(0);
+    vector<int> n_summands(m, 21410970 / m);
+
+    for (auto _ : state) {
+        ReductionPlan plan(m / 2, n_summands);
+        benchmark::DoNotOptimize(plan.operations.data());
+    }
+}
+BENCHMARK(BM_planConstruction)->RangeMultiplier(8)->Range(8, 4096);
+
 static void BM_noCheckIterative(benchmark::State& state) {
     const int n = state.range(0);
 
@@ -135,7 +304,7 @@ static void BM_accumulative(benchmark::State& state) {
 BENCHMARK(BM_accumulative)->RangeMultiplier(8)->Range(1, 1 << 27)->Iterations(1);
 
 
-__attribute__((optimize("O3"))) static void BM_avxsubtree8(benchmark::State& state) {
+__attribute__((optimize("O3"), target("avx2"))) static void BM_avxsubtree8(benchmark::State& state) {
     const size_t n = 1 * 256 * 1024 * 1024 / sizeof(double);
     vector<double> results(n);
 
@@ -167,6 +336,31 @@ __attribute__((optimize("O3"))) static void BM_avxsubtree8(benchmark::State& sta
 }
 BENCHMARK(BM_avxsubtree8)->Iterations(1);
 
+/* Throughput of a single pass of the accumulation kernels, compare with BM_accumulative */
+static void BM_kernelPass(benchmark::State& state) {
+    const KernelVariant variant = static_cast<KernelVariant>(state.range(0));
+    const size_t n = 1 * 256 * 1024 * 1024 / sizeof(double);
+
+    if (!TreeKernels::supported(variant)) {
+        state.SkipWithError("Kernel not supported by this CPU");
+        return;
+    }
+
+    const AccumulationKernel &kernel = TreeKernels::get(variant);
+    vector<double> data(n, 1.0);
+    vector<double> results(n >> kernel.levels);
+    state.SetLabel(kernel.name);
+
+    for (auto _ : state) {
+        kernel.reduce(data.data(), results.data(), results.size());
+        benchmark::DoNotOptimize(results.data());
+    }
+
+    state.SetBytesProcessed(state.iterations() * n * sizeof(double));
+}
+BENCHMARK(BM_kernelPass)->DenseRange(static_cast<int>(KernelVariant::SCALAR),
+        static_cast<int>(KernelVariant::AVX512));
+
 __attribute__((optimize("O3"))) static void BM_subtree8(benchmark::State& state) {
     const size_t n = 1 * 256 * 1024 * 1024 / sizeof(double);
     assert(n % 8 == 0);
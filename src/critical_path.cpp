@@ -1,4 +1,5 @@
 #include "critical_path.hpp"
+#include <strategies/reduction_plan.hpp>
 #include <algorithm>
 #include <map>
 #include <cassert>
@@ -95,6 +96,26 @@ const double Info::time(void) const {
     return tree(0, maxY);
 }
 
+/* Replay the reduction plans of all ranks with a send schedule, where every subtree is computed
+ * after the previous one and sent together with the others of its message */
+void simulate_schedule(const uint64_t n, const int m, const double t_send, const double t_add,
+        const SendSchedule schedule, const char *name) {
+    // Same distribution as calcStartIndicesMap
+    vector<int> n_summands;
+    for (int i = 0; i < m; i++) {
+        n_summands.push_back(n / m + ((i >= m - static_cast<int>(n % m)) ? 1 : 0));
+    }
+
+    const auto timings = ReductionPlan::simulate(n_summands, false, schedule, true, t_send / t_add);
+
+    uint64_t messages = 0;
+    for (int rank = 0; rank < m; rank++) {
+        messages += ReductionPlan(rank, n_summands, false, false, schedule).outgoingMessages.size();
+    }
+
+    printf("%s: Σ = %f, messages = %lu\n", name, timings.at(0).completed * t_add, messages);
+}
+
 #ifdef CRITICAL_PATH_MAIN
 int main(int argc, char **argv) {
     if (argc != 4 + 1) {
@@ -114,6 +135,9 @@ int main(int argc, char **argv) {
 
     printf("Σ = %f\n", i.time());
 
+    simulate_schedule(n, m, t_send, t_add, SendSchedule::LOCAL_WORK, "local-work");
+    simulate_schedule(n, m, t_send, t_add, SendSchedule::CRITICAL_PATH, "critical-path");
+
     return 0;
 }
 #endif
@@ -87,6 +87,17 @@ enum SummationStrategies parse_mode_arg(string arg) {
 
 
 
+/* Trees of all reduction operators take the same options */
+template<typename Tree> std::unique_ptr<SummationStrategy> make_tree(const int rank, vector<int> &n_summands,
+        MPI_Comm comm, const TransportMode transport, const Finalization finalization,
+        const SendSchedule sendSchedule, const Scheduling scheduling, const int threads, const bool progressThread) {
+    auto tree = std::make_unique<Tree>(rank, n_summands, comm, transport, finalization, sendSchedule);
+    tree->setThreads(threads);
+    tree->setScheduling(scheduling);
+    tree->setProgressThread(progressThread);
+    return tree;
+}
+
 void cli_error(const cxxopts::Options options, const string error) {
     if (c_rank != 0) return;
     cerr << "[ERROR] " << error << "\n\n";
@@ -95,7 +106,10 @@ void cli_error(const cxxopts::Options options, const string error) {
 
 
 int main(int argc, char **argv) {
-    MPI_Init(&argc, &argv);
+    // Additional threads just sum local blocks, only the optional progress thread communicates
+    // besides the main thread, but never at the same time
+    int threadSupport;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &threadSupport);
     MPI_Comm_rank(MPI_COMM_WORLD, &c_rank);
     MPI_Comm_size(MPI_COMM_WORLD, &c_size);
 
@@ -110,9 +124,18 @@ int main(int argc, char **argv) {
         ("f,file", "File name of the binary psllh file", cxxopts::value<string>())
         ("r,repetitions", "Repeat the calculation at most n times", cxxopts::value<unsigned long>()->default_value("1"))
         ("c,distribution", "Number distribution, can be even, optimal or optimized,<VARIANCE>. Only relevant in tree mode", cxxopts::value<string>()->default_value("even"))
+        ("transport", "Communication of intermediary results in tree mode, can be isend, persistent, shared, rma or neighborhood", cxxopts::value<string>()->default_value("isend"))
+        ("schedule", "Order of subtree computations in tree mode, can be inorder or dataflow", cxxopts::value<string>()->default_value("inorder"))
+        ("send-schedule", "When subtrees going to the same rank are sent together in tree mode, can be local-work or critical-path", cxxopts::value<string>()->default_value("local-work"))
+        ("finalize", "How all ranks obtain the result in tree mode, can be broadcast or butterfly", cxxopts::value<string>()->default_value("broadcast"))
+        ("operator", "Reduction operator in tree mode, can be sum, min, max, product or logsumexp", cxxopts::value<string>()->default_value("sum"))
         ("n", "Use at most n numbers from the supplied data file", cxxopts::value<unsigned int>()->default_value(to_string(numeric_limits<unsigned int>::max())))
         ("m", "Use at most m ranks", cxxopts::value<int>()->default_value(to_string(numeric_limits<int>::max())))
         ("workload", "Calculate square of all numbers in a loop with that many iterations as workload simulation", cxxopts::value<unsigned int>()->default_value("0"))
+        ("threads", "Number of threads per rank that compute local blocks in tree mode", cxxopts::value<int>()->default_value("1"))
+        ("progress-thread", "Let a dedicated thread communicate while large local blocks are computed in tree mode", cxxopts::value<bool>()->default_value("false"))
+        ("overlap", "Run the workload simulation while a nonblocking reduction is in flight", cxxopts::value<bool>()->default_value("false"))
+        ("reduce-to", "Deliver the result only to the given rank instead of all ranks", cxxopts::value<int>()->default_value("-1"))
         ("v,verbose", "Be more verbose about calculations", cxxopts::value<bool>()->default_value("false"))
         ("d,debug", "Pause until debugger is attached to given rank", cxxopts::value<int>()->default_value("-1"))
         ("h,help", "Display this help message", cxxopts::value<bool>()->default_value("false"));
@@ -155,6 +178,69 @@ int main(int argc, char **argv) {
     }
 
     string distrib_mode = result["distribution"].as<string>();
+
+    TransportMode transport_mode;
+    const string transport = result["transport"].as<string>();
+    if (transport == "isend") {
+        transport_mode = TransportMode::ISEND;
+    } else if (transport == "persistent") {
+        transport_mode = TransportMode::PERSISTENT;
+    } else if (transport == "shared") {
+        transport_mode = TransportMode::SHARED;
+    } else if (transport == "rma") {
+        transport_mode = TransportMode::RMA;
+    } else if (transport == "neighborhood") {
+        transport_mode = TransportMode::NEIGHBORHOOD;
+    } else {
+        cli_error(options, "Invalid transport: " + transport);
+        return -1;
+    }
+
+    Scheduling scheduling;
+    const string schedule = result["schedule"].as<string>();
+    if (schedule == "inorder") {
+        scheduling = Scheduling::IN_ORDER;
+    } else if (schedule == "dataflow") {
+        scheduling = Scheduling::DATAFLOW;
+    } else {
+        cli_error(options, "Invalid schedule: " + schedule);
+        return -1;
+    }
+
+    if (scheduling != Scheduling::IN_ORDER && transport_mode == TransportMode::NEIGHBORHOOD) {
+        cli_error(options, "The neighborhood transport can only be combined with the inorder schedule");
+        return -1;
+    }
+
+    SendSchedule send_schedule;
+    const string sendSchedule = result["send-schedule"].as<string>();
+    if (sendSchedule == "local-work") {
+        send_schedule = SendSchedule::LOCAL_WORK;
+    } else if (sendSchedule == "critical-path") {
+        send_schedule = SendSchedule::CRITICAL_PATH;
+    } else {
+        cli_error(options, "Invalid send schedule: " + sendSchedule);
+        return -1;
+    }
+
+    Finalization finalization;
+    const string finalize = result["finalize"].as<string>();
+    if (finalize == "broadcast") {
+        finalization = Finalization::BROADCAST;
+    } else if (finalize == "butterfly") {
+        finalization = Finalization::BUTTERFLY;
+    } else {
+        cli_error(options, "Invalid finalization: " + finalize);
+        return -1;
+    }
+
+    const string reductionOperator = result["operator"].as<string>();
+    if (reductionOperator != "sum" && reductionOperator != "min" && reductionOperator != "max"
+            && reductionOperator != "product" && reductionOperator != "logsumexp") {
+        cli_error(options, "Invalid operator: " + reductionOperator);
+        return -1;
+    }
+
     string filename;
     try {
         filename = result["file"].as<string>();
@@ -171,6 +257,34 @@ int main(int argc, char **argv) {
     }
 
     int workloadIterations = result["workload"].as<unsigned int>();
+    const bool overlap = result["overlap"].as<bool>();
+    const int reduceTo = result["reduce-to"].as<int>();
+    if (reduceTo >= c_size) {
+        cli_error(options, "Result rank must be part of the cluster");
+        return -1;
+    }
+    if (reduceTo >= 0 && overlap) {
+        cli_error(options, "Reducing to a single rank can not be combined with --overlap");
+        return -1;
+    }
+    // Rank that reports the result and the timings
+    const int outputRank = std::max(reduceTo, 0);
+
+    const int threads = result["threads"].as<int>();
+    if (threads < 1) {
+        cli_error(options, "Number of threads must be positive integer");
+        return -1;
+    }
+    if (threads > 1 && threadSupport < MPI_THREAD_FUNNELED) {
+        cli_error(options, "MPI library does not support multiple threads per rank");
+        return -1;
+    }
+    const bool useProgressThread = result["progress-thread"].as<bool>();
+    if (useProgressThread && threadSupport < MPI_THREAD_SERIALIZED) {
+        cli_error(options, "MPI library does not support communication from a progress thread");
+        return -1;
+    }
+
 
 
 
@@ -201,7 +315,7 @@ int main(int argc, char **argv) {
 	    }
             initialized = true;
         } else if (distrib_mode == "optimal") {
-            d = Distribution::optimal(summands.size(), targetClusterSize);
+            d = Distribution::optimal(summands.size(), targetClusterSize, threads);
             initialized = true;
         } else if (distrib_mode.starts_with("manual,")) {
             d = Distribution::from_string(distrib_mode.substr(7));
@@ -257,6 +371,11 @@ int main(int argc, char **argv) {
     if (summands_per_rank.size() == 0) {
         return -1;
     } 
+    if (static_cast<size_t>(outputRank) >= summands_per_rank.size()) {
+        cli_error(options, "Result rank has no summands assigned");
+        MPI_Finalize();
+        return -1;
+    }
     if (!rankHasSummands) {
 	// Nothing to do for this process
 	MPI_Finalize();
@@ -276,11 +395,27 @@ int main(int argc, char **argv) {
             if(c_rank == 0)
             cout << "Strategy: Baseline" << endl;
             break;
-        case TREE:
-            strategy = std::make_unique<BinaryTreeSummation>(c_rank, summands_per_rank, comm);
+        case TREE: {
+            if (reductionOperator == "min") {
+                strategy = make_tree<TreeReduction<MinOperator>>(c_rank, summands_per_rank, comm, transport_mode,
+                        finalization, send_schedule, scheduling, threads, useProgressThread);
+            } else if (reductionOperator == "max") {
+                strategy = make_tree<TreeReduction<MaxOperator>>(c_rank, summands_per_rank, comm, transport_mode,
+                        finalization, send_schedule, scheduling, threads, useProgressThread);
+            } else if (reductionOperator == "product") {
+                strategy = make_tree<TreeReduction<ProductOperator>>(c_rank, summands_per_rank, comm, transport_mode,
+                        finalization, send_schedule, scheduling, threads, useProgressThread);
+            } else if (reductionOperator == "logsumexp") {
+                strategy = make_tree<TreeReduction<LogSumExpOperator>>(c_rank, summands_per_rank, comm, transport_mode,
+                        finalization, send_schedule, scheduling, threads, useProgressThread);
+            } else {
+                strategy = make_tree<BinaryTreeSummation>(c_rank, summands_per_rank, comm, transport_mode,
+                        finalization, send_schedule, scheduling, threads, useProgressThread);
+            }
             if(c_rank == 0)
-            cout << "Strategy: Tree" << endl;
+            cout << "Strategy: Tree (" << reductionOperator << ")" << endl;
             break;
+        }
         case REPROBLAS:
             strategy = std::make_unique<ReproBLASSummation>(c_rank, summands_per_rank, comm);
             if(c_rank == 0)
@@ -306,15 +441,27 @@ int main(int argc, char **argv) {
 
     volatile double globalWorkloadAccumulator = 0.0; // used for fake calculations
     for (unsigned long int i = 0; i < repetitions; i++) {
-        // Simulate workload
-        for (unsigned int j = 0; j < workloadIterations; j++) {
-            for (auto x : strategy->getSummands()) {
-                globalWorkloadAccumulator = globalWorkloadAccumulator + x * x;
+        if (overlap) {
+            // Simulate workload that does not depend on the result, testing the request in between
+            auto request = strategy->iaccumulate();
+            for (unsigned int j = 0; j < workloadIterations; j++) {
+                for (auto x : strategy->getSummands()) {
+                    globalWorkloadAccumulator = globalWorkloadAccumulator + x * x;
+                }
+                request->test();
+            }
+            sum = request->wait();
+        } else {
+            // Simulate workload
+            for (unsigned int j = 0; j < workloadIterations; j++) {
+                for (auto x : strategy->getSummands()) {
+                    globalWorkloadAccumulator = globalWorkloadAccumulator + x * x;
 
+                }
             }
+            sum = (reduceTo >= 0) ? strategy->accumulate_to(reduceTo) : strategy->accumulate();
         }
-        sum = strategy->accumulate();
-        if (c_rank == 0) {
+        if (c_rank == outputRank) {
             timepoints.push_back(std::chrono::high_resolution_clock::now());
         }
     }
@@ -324,7 +471,7 @@ int main(int argc, char **argv) {
     }
 
 
-    if (c_rank == 0 && repetitions != 0) {
+    if (c_rank == outputRank && repetitions != 0) {
         // Turn the timepoints into durations
         std::vector<double> durations;
         durations.reserve(repetitions);
@@ -20,7 +20,7 @@ using std::string;
 using std::stringstream;
 
 Distribution::Distribution(uint64_t n, uint64_t ranks)
-        : n(n), ranks(ranks), nSummands(ranks), startIndices(ranks), _rankIntersectionCount(-1) {
+        : n(n), ranks(ranks), threadsPerRank(1), nSummands(ranks), startIndices(ranks), _rankIntersectionCount(-1) {
 }
 
 const Distribution Distribution::even(uint64_t n, uint64_t ranks) {
@@ -110,7 +110,7 @@ const Distribution Distribution::lsb_cleared(const uint64_t n, const uint64_t ra
     return d;
 }
 
-const Distribution Distribution::optimal(const uint64_t n, const uint64_t ranks) {
+const Distribution Distribution::optimal(const uint64_t n, const uint64_t ranks, const uint64_t threadsPerRank) {
     Distribution candidate(1,1);
     double score = INFINITY;
     double candidateVariance = 1.0;
@@ -119,6 +119,7 @@ const Distribution Distribution::optimal(const uint64_t n, const uint64_t ranks)
 
     for (double testedVariance = 0.0; testedVariance < 1.0; testedVariance += 0.0001) {
         auto generated = Distribution::lsb_cleared(n, ranks, testedVariance);
+        generated.threadsPerRank = threadsPerRank;
 
         if (generated.score() < score) {
             candidate = generated;
@@ -198,7 +199,7 @@ const double Distribution::score() const {
     const double t_doubleadd = 2.44e-9;
 
     return t_send * rankIntersectionCount() + // communication
-        *std::max_element(nSummands.begin(), nSummands.end()) * t_doubleadd;  // calculation
+        *std::max_element(nSummands.begin(), nSummands.end()) * t_doubleadd / threadsPerRank;  // calculation
 }
 
 const void Distribution::printScore() const {
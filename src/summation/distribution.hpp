@@ -15,6 +15,7 @@ using std::string;
 struct Distribution {
     uint64_t n;         // number of summands
     uint64_t ranks;     // number of ranks
+    uint64_t threadsPerRank;    // number of workers that share the summands of a rank
     vector<uint64_t> nSummands;
     vector<uint64_t> startIndices;
 
@@ -35,7 +36,9 @@ struct Distribution {
 
     static const Distribution lsb_cleared(const uint64_t n, const uint64_t ranks, const float variance);
 
-    static const Distribution optimal(const uint64_t n, const uint64_t ranks);
+    /* Search the distribution with the best score. With multiple threads per rank, computation
+     * becomes cheaper relative to communication, which favors fewer rank intersections */
+    static const Distribution optimal(const uint64_t n, const uint64_t ranks, const uint64_t threadsPerRank = 1);
 
     static const Distribution from_string(const string description);
 
@@ -14,3 +14,12 @@ double AllreduceSummation::accumulate() {
 
     return globalSum;
 }
+
+std::unique_ptr<AccumulationRequest> AllreduceSummation::iaccumulate() {
+    auto request = std::make_unique<MPIAccumulationRequest>();
+    request->localSum = std::accumulate(summands.begin(), summands.end(), 0.0);
+    MPI_Iallreduce(&request->localSum, &request->result, 1, MPI_DOUBLE, MPI_SUM, comm,
+            &request->request);
+
+    return request;
+}
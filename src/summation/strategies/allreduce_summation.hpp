@@ -11,6 +11,7 @@ class AllreduceSummation : public SummationStrategy {
 public:
     using SummationStrategy::SummationStrategy;
     double accumulate();
+    std::unique_ptr<AccumulationRequest> iaccumulate();
 
 };
 
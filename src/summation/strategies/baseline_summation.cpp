@@ -7,6 +7,15 @@
 #include <numeric>
 
 double BaselineSummation::accumulate() {
+    double globalSum = accumulate_to(ROOT_RANK);
+
+    MPI_Bcast(&globalSum, 1, MPI_DOUBLE,
+              ROOT_RANK, comm);
+
+    return globalSum;
+}
+
+double BaselineSummation::accumulate_to(const int root) {
     std::vector<double> allSummands;
     allSummands.resize(globalSize);
 
@@ -14,15 +23,13 @@ double BaselineSummation::accumulate() {
                 &allSummands[0],
                 reinterpret_cast<const int *>(&n_summands[0]),
                 reinterpret_cast<const int*>(&startIndex[0]),
-                MPI_DOUBLE, ROOT_RANK, comm
+                MPI_DOUBLE, root, comm
     );
 
-    double globalSum;
-    if (rank == ROOT_RANK) {
+    double globalSum = 0.0;
+    if (rank == root) {
         globalSum = std::accumulate(allSummands.begin(), allSummands.end(), 0.0);
     }
-    MPI_Bcast(&globalSum, 1, MPI_DOUBLE,
-              ROOT_RANK, comm);
 
     return globalSum;
 }
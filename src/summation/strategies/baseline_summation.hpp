@@ -11,6 +11,7 @@ class BaselineSummation : public SummationStrategy {
 public:
     using SummationStrategy::SummationStrategy;
     double accumulate();
+    double accumulate_to(const int root);
 
 };
 
@@ -5,187 +5,1178 @@
 #include <exception>
 #include <vector>
 #include <numeric>
+#include <algorithm>
 #include <cstring>
+#include <cstddef>
 #include <cassert>
 #include <cmath>
 #include <unistd.h>
 #include <memory>
 #include <functional>
+#include <type_traits>
 #include <chrono>
+#include <atomic>
+#include <thread>
 #include <io.hpp>
 #include <util.hpp>
 #include "binary_tree.hpp"
 
-#ifdef AVX
-#include <immintrin.h>
-#endif
-
 #undef DEBUG_OUTPUT_TREE
 
 using namespace std;
 using namespace std::string_literals;
 
-const int MESSAGEBUFFER_MPI_TAG = 1;
-
-MessageBuffer::MessageBuffer(MPI_Comm comm) : targetRank(-1),
-    inbox(),
+const int BUTTERFLY_MPI_TAG = 0;
+const int RESULT_MPI_TAG = 1;
+const int MESSAGEBUFFER_MPI_TAG = 2;    // the persistent transport adds the sequence of the message
+
+template <typename Value>
+MessageBuffer<Value>::MessageBuffer(MPI_Comm comm, const ReductionPlan &plan) : plan(plan),
+    inbox(plan.remoteValueCount),
+    arrived(plan.remoteValueCount, false),
+    targetRank(-1),
+    sendBufferSize(1),
+    sendPoolRequests(SEND_POOL_SIZE, MPI_REQUEST_NULL),
+    completedSends(SEND_POOL_SIZE),
+    currentSendBuffer(-1),
+    outboxSize(0),
     awaitedNumbers(0),
     sentMessages(0),
     sentSummands(0),
-    sendBufferClear(true),
+    sentBytes(0),
+    sendPoolExhausted(0),
     comm(comm)
     {
-    outbox.reserve(MAX_MESSAGE_LENGTH + 1);
-    buffer.resize(MAX_MESSAGE_LENGTH);
-    reqs.reserve(16);
+    for (const PlanMessage &message : plan.outgoingMessages) {
+        if (!messageCapacity.contains(message.peer)) {
+            messageCapacity[message.peer] = plan.messageCapacity(message.peer);
+            sendBufferSize = std::max(sendBufferSize, messageCapacity[message.peer]);
+        }
+    }
+    for (const PlanOperation &op : plan.operations) {
+        if (op.type == PlanOperation::REMOTE_VALUE) {
+            expectedValues[op.rank]++;
+        }
+    }
+
+    sendPool.resize(SEND_POOL_SIZE * sendBufferSize);
+    // Without the incoming messages of the plan, no message can hold more than all remote values
+    buffer.resize(std::max(plan.withIncomingMessages ? plan.largestIncomingMessage : plan.remoteValueCount, 1U));
+
+    for (int i = SEND_POOL_SIZE - 1; i >= 0; i--) {
+        freeSendBuffers.push_back(i);
+    }
 }
 
-void MessageBuffer::wait() {
-    for (MPI_Request &r : reqs) {
-        MPI_Wait(&r, MPI_STATUS_IGNORE);
+template <typename Value>
+MessageBuffer<Value>::~MessageBuffer() {
+}
+
+template <typename Value>
+void MessageBuffer<Value>::startReduction() {
+    std::fill(arrived.begin(), arrived.end(), false);
+    outstandingValues = expectedValues;
+}
+
+template <typename Value>
+void MessageBuffer<Value>::deliver(const uint32_t position, const Value value) {
+    inbox[position] = value;
+    arrived[position] = true;
+}
+
+template <typename Value>
+bool MessageBuffer<Value>::take(const uint32_t position, Value &value) {
+    if (!arrived[position]) return false;
+
+    arrived[position] = false;
+    value = inbox[position];
+    return true;
+}
+
+template <typename Value>
+vector<uint32_t> MessageBuffer<Value>::targetPositions() const {
+    int size;
+    MPI_Comm_size(comm, &size);
+
+    // The values a source sends us occupy consecutive positions, tell every source where they start
+    vector<uint32_t> firstPosition(size, 0);
+    vector<uint32_t> peerFirstPosition(size);
+    for (const PlanMessage &m : plan.incomingMessages) {
+        if (m.sequence == 0) {
+            firstPosition[m.peer] = plan.incomingPositions[m.first];
+        }
     }
+    MPI_Alltoall(&firstPosition[0], 1, MPI_UINT32_T, &peerFirstPosition[0], 1, MPI_UINT32_T, comm);
 
-    reqs.clear();
-    sendBufferClear = true;
+    vector<uint32_t> positions;
+    for (const PlanSubtree &subtree : plan.subtrees) {
+        if (subtree.targetRank >= 0) {
+            positions.push_back(peerFirstPosition[subtree.targetRank]++);
+        }
+    }
+
+    return positions;
+}
+
+template <typename Value>
+int MessageBuffer<Value>::sendsInFlight() const {
+    return SEND_POOL_SIZE - freeSendBuffers.size() - (currentSendBuffer == -1 ? 0 : 1);
+}
+
+template <typename Value>
+void MessageBuffer<Value>::wait() {
+    if (sendsInFlight() == 0) return;
+
+    MPI_Waitall(SEND_POOL_SIZE, &sendPoolRequests[0], MPI_STATUSES_IGNORE);
+
+    freeSendBuffers.clear();
+    for (int i = SEND_POOL_SIZE - 1; i >= 0; i--) {
+        if (i != currentSendBuffer) freeSendBuffers.push_back(i);
+    }
+}
+
+template <typename Value>
+int MessageBuffer<Value>::acquireSendBuffer() {
+    if (freeSendBuffers.empty()) {
+        reclaimSendBuffers(false);
+    }
+
+    if (freeSendBuffers.empty()) {
+        sendPoolExhausted++;
+        reclaimSendBuffers(true);
+    }
+
+    const int sendBuffer = freeSendBuffers.back();
+    freeSendBuffers.pop_back();
+    return sendBuffer;
 }
 
+template <typename Value>
+void MessageBuffer<Value>::reclaimSendBuffers(const bool blocking) {
+    // Completed requests are set to MPI_REQUEST_NULL, so free buffers are ignored
+    int completed;
+    if (blocking) {
+        MPI_Waitany(SEND_POOL_SIZE, &sendPoolRequests[0], &completedSends[0], MPI_STATUS_IGNORE);
+        completed = (completedSends[0] == MPI_UNDEFINED) ? 0 : 1;
+    } else {
+        MPI_Testsome(SEND_POOL_SIZE, &sendPoolRequests[0], &completed, &completedSends[0],
+                MPI_STATUSES_IGNORE);
+        if (completed == MPI_UNDEFINED) completed = 0;
+    }
+
+    for (int i = 0; i < completed; i++) {
+        freeSendBuffers.push_back(completedSends[i]);
+    }
+}
 
-void MessageBuffer::flush() {
+template <typename Value>
+void MessageBuffer<Value>::flush() {
     if(targetRank == -1) return;
-    MPI_Request r;
-    reqs.push_back(r);
 
-    const int messageByteSize = sizeof(MessageBufferEntry) * outbox.size();
+    const int messageByteSize = sizeof(MessageBufferEntry<Value>) * outboxSize;
 
     assert(0 < targetRank < 128);
-    MPI_Isend(static_cast<void *>(&outbox[0]), messageByteSize, MPI_BYTE, targetRank,
-            MESSAGEBUFFER_MPI_TAG, comm, &reqs.back());
+    MPI_Isend(static_cast<void *>(&sendPool[currentSendBuffer * sendBufferSize]), messageByteSize, MPI_BYTE, targetRank,
+            MESSAGEBUFFER_MPI_TAG, comm, &sendPoolRequests[currentSendBuffer]);
     sentMessages++;
+    sentBytes += messageByteSize;
 
     targetRank = -1;
-    outbox.clear();
-    sendBufferClear = false;
+    currentSendBuffer = -1;
+    outboxSize = 0;
 }
 
-const void MessageBuffer::receive(const int sourceRank) {
+template <typename Value>
+const void MessageBuffer<Value>::receive(const int sourceRank) {
     assert(0 < sourceRank < 128);
     MPI_Status status;
 
-    MPI_Recv(static_cast<void *>(&buffer[0]), sizeof(MessageBufferEntry) * MAX_MESSAGE_LENGTH, MPI_BYTE,
+    MPI_Recv(static_cast<void *>(&buffer[0]), sizeof(MessageBufferEntry<Value>) * buffer.size(), MPI_BYTE,
             sourceRank, MESSAGEBUFFER_MPI_TAG, comm, &status);
     awaitedNumbers++;
 
-    const int receivedEntries = status._ucount / sizeof(MessageBufferEntry);
+    const int receivedEntries = status._ucount / sizeof(MessageBufferEntry<Value>);
+    outstandingValues[sourceRank] -= receivedEntries;
 
     for (int i = 0; i < receivedEntries; i++) {
-        MessageBufferEntry entry = buffer[i];
-        inbox[entry.index] = entry.value;
+        MessageBufferEntry<Value> entry = buffer[i];
+        deliver(plan.remotePosition(entry.index), entry.value);
     }
 }
 
-void MessageBuffer::put(const int targetRank, const uint64_t index, const double value) {
-    if (outbox.size() >= MAX_MESSAGE_LENGTH || this->targetRank != targetRank) {
+template <typename Value>
+void MessageBuffer<Value>::put(const int targetRank, const uint64_t index, const Value value) {
+    const uint32_t capacity = messageCapacity[targetRank];
+    if (outboxSize >= capacity || this->targetRank != targetRank) {
         flush();
     }
 
-    /* Since we send asynchronously, we must check whether the buffer can currently be written to */
-    if(!sendBufferClear) {
-        wait();
-    }
-
-    if (this->targetRank == -1) {
+    /* Messages that have been sent asynchronously keep their buffer until they are completed,
+     * so the next message goes into a free one */
+    if (currentSendBuffer == -1) {
+        currentSendBuffer = acquireSendBuffer();
         this->targetRank = targetRank;
     }
 
-    MessageBufferEntry e;
+    MessageBufferEntry<Value> &e = sendPool[currentSendBuffer * sendBufferSize + outboxSize++];
     e.index = index;
     e.value = value;
-    outbox.push_back(e);
 
-    if (outbox.size() == MAX_MESSAGE_LENGTH) flush();
+    if (outboxSize == capacity) flush();
 
     sentSummands++;
 }
 
-const double MessageBuffer::get(const int sourceRank, const uint64_t index) {
+template <typename Value>
+const Value MessageBuffer<Value>::get(const int sourceRank, const uint32_t position) {
     // If we have the number in our inbox, directly return it
-    if (inbox.contains(index)) {
-        double result = inbox[index];
-        inbox.erase(index);
+    Value result;
+    if (take(position, result)) {
         return result;
     }
 
     // If not, we will wait for a message, but make sure no one is waiting for our results.
     flush();
-    wait();
-    receive(sourceRank);
-
-    //cout << "Waiting for rank " << sourceRank << ", index " << index ;
 
-    // Our computation order should guarantee that the number is contained within
-    // the next package
-    assert(inbox.contains(index));
+    // In plan order, the number is contained within the next package. Other schedules may send
+    // the subtrees of a rank in a different order.
+    do {
+        receive(sourceRank);
+    } while (!take(position, result));
 
-    //cout << " [RECEIVED]" << endl;
-    double result = inbox[index];
-    inbox.erase(index);
     return result;
 }
 
-const void MessageBuffer::printStats() const {
+template <typename Value>
+bool MessageBuffer<Value>::tryGet(const int sourceRank, const uint32_t position, Value &value) {
+    if (take(position, value)) {
+        return true;
+    }
+
+    // Make sure no one is waiting for our results, then look for messages that have arrived
+    flush();
+
+    int messageAvailable = true;
+    while (messageAvailable) {
+        MPI_Iprobe(sourceRank, MESSAGEBUFFER_MPI_TAG, comm, &messageAvailable, MPI_STATUS_IGNORE);
+        if (messageAvailable) {
+            receive(sourceRank);
+            if (take(position, value)) return true;
+        }
+    }
+
+    return false;
+}
+
+template <typename Value>
+bool MessageBuffer<Value>::receiveAny(const bool blocking) {
+    // Make sure no one is waiting for our results
+    flush();
+
+    while (true) {
+        if (receiveAvailable()) return true;
+        if (!blocking) return false;
+    }
+}
+
+template <typename Value>
+bool MessageBuffer<Value>::receiveAvailable() {
+    /* Only sources that still owe us values are probed. Unless a broadcast separates two reductions,
+     * see BinaryTreeSummation::accumulate_to, a source that is done may already send the values of the
+     * next one, which have to stay queued until then */
+    for (const auto &[source, outstanding] : outstandingValues) {
+        if (outstanding == 0) continue;
+
+        int messageAvailable;
+        MPI_Iprobe(source, MESSAGEBUFFER_MPI_TAG, comm, &messageAvailable, MPI_STATUS_IGNORE);
+        if (messageAvailable) {
+            receive(source);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <typename Value>
+bool MessageBuffer<Value>::test() {
+    if (sendsInFlight() > 0) {
+        reclaimSendBuffers(false);
+    }
+
+    return sendsInFlight() == 0;
+}
+
+template <typename Value>
+const void MessageBuffer<Value>::printStats() const {
     int rank;
     MPI_Comm_rank(comm, &rank);
 
-    size_t globalStats[] {0, 0, 0};
-    size_t localStats[] {sentMessages, sentMessages, sentSummands};
+    size_t globalStats[] {0, 0, 0, 0};
+    size_t localStats[] {sentMessages, sentBytes, sentSummands, sendPoolExhausted};
 
-    MPI_Reduce(localStats, globalStats, 3, MPI_LONG, MPI_SUM,
+    MPI_Reduce(localStats, globalStats, 4, MPI_LONG, MPI_SUM,
             0, comm);
 
     if (rank == 0) {
-        printf("sentMessages=%li\naverageSummandsPerMessage=%f\n",
+        printf("sentMessages=%li\naverageSummandsPerMessage=%f\naverageBytesPerMessage=%f\nsendPoolExhausted=%li\n",
                 globalStats[0],
-                globalStats[2] / static_cast<double>(globalStats[0]));
+                globalStats[2] / static_cast<double>(globalStats[0]),
+                globalStats[1] / static_cast<double>(globalStats[0]),
+                globalStats[3]);
+
+    }
+
+}
+
+
+template <typename Value>
+PersistentMessageBuffer<Value>::PersistentMessageBuffer(MPI_Comm comm, const ReductionPlan &plan)
+    : MessageBuffer<Value>(comm, plan),
+      sendBuffer(plan.subtrees.size()),
+      receiveBuffer(plan.incomingIndices.size()),
+      sendRequests(plan.outgoingMessages.size()),
+      receiveRequests(plan.incomingMessages.size()),
+      filledEntries(plan.outgoingMessages.size()),
+      startedMessages(0),
+      receiveStatuses(plan.incomingMessages.size()),
+      completedReceives(plan.incomingMessages.size()),
+      unpacked(plan.incomingMessages.size())
+{
+    for (const PlanSubtree &subtree : plan.subtrees) {
+        if (subtree.targetRank >= 0) {
+            outgoingIndices.push_back(subtree.index);
+        }
+    }
+
+    for (size_t i = 0; i < plan.outgoingMessages.size(); i++) {
+        const PlanMessage &m = plan.outgoingMessages[i];
+        MPI_Send_init(static_cast<void *>(&sendBuffer[m.first]), sizeof(PlanMessageEntry<Value>) * m.count,
+                MPI_BYTE, m.peer, MESSAGEBUFFER_MPI_TAG + m.sequence, comm, &sendRequests[i]);
+        entryMessage.insert(entryMessage.end(), m.count, i);
+    }
+
+    for (size_t i = 0; i < plan.incomingMessages.size(); i++) {
+        const PlanMessage &m = plan.incomingMessages[i];
+        MPI_Recv_init(static_cast<void *>(&receiveBuffer[m.first]), sizeof(PlanMessageEntry<Value>) * m.count,
+                MPI_BYTE, m.peer, MESSAGEBUFFER_MPI_TAG + m.sequence, comm, &receiveRequests[i]);
+        pendingMessages[m.peer].push_back(i);
+    }
+}
+
+template <typename Value>
+PersistentMessageBuffer<Value>::~PersistentMessageBuffer() {
+    int finalized;
+    MPI_Finalized(&finalized);
+    if (finalized) return;
+
+    for (MPI_Request &r : sendRequests) MPI_Request_free(&r);
+    for (MPI_Request &r : receiveRequests) MPI_Request_free(&r);
+}
+
+template <typename Value>
+void PersistentMessageBuffer<Value>::startReduction() {
+    std::fill(filledEntries.begin(), filledEntries.end(), 0);
+    std::fill(unpacked.begin(), unpacked.end(), false);
+    startedMessages = 0;
+    std::fill(this->arrived.begin(), this->arrived.end(), false);
+    for (auto &[source, next] : nextPendingMessage) {
+        next = 0;
+    }
+
+    if (!receiveRequests.empty()) {
+        MPI_Startall(receiveRequests.size(), &receiveRequests[0]);
+    }
+}
+
+template <typename Value>
+void PersistentMessageBuffer<Value>::flush() {
+    // Messages are started as soon as they are complete
+}
+
+template <typename Value>
+void PersistentMessageBuffer<Value>::wait() {
+    assert(startedMessages == this->plan.outgoingMessages.size());
+
+    if (!sendRequests.empty()) {
+        MPI_Waitall(sendRequests.size(), &sendRequests[0], MPI_STATUSES_IGNORE);
+    }
+    if (!receiveRequests.empty()) {
+        MPI_Waitall(receiveRequests.size(), &receiveRequests[0], MPI_STATUSES_IGNORE);
+    }
+}
+
+template <typename Value>
+void PersistentMessageBuffer<Value>::put(const int targetRank, const uint64_t index, const Value value) {
+    // Subtrees are numbered by their index, which gives their position in the outgoing messages
+    const auto it = std::lower_bound(outgoingIndices.begin(), outgoingIndices.end(), index);
+    assert(it != outgoingIndices.end() && *it == index);
+    const uint32_t entry = it - outgoingIndices.begin();
+    const uint32_t messageIndex = entryMessage[entry];
+    assert(this->plan.outgoingMessages[messageIndex].peer == targetRank);
+
+#ifdef CHECK_MESSAGE_INDICES
+    sendBuffer[entry] = MessageBufferEntry<Value> { index, value };
+#else
+    sendBuffer[entry] = value;
+#endif
+    this->sentSummands++;
+
+    if (++filledEntries[messageIndex] == this->plan.outgoingMessages[messageIndex].count) {
+        MPI_Start(&sendRequests[messageIndex]);
+        startedMessages++;
+        this->sentMessages++;
+        this->sentBytes += sizeof(PlanMessageEntry<Value>) * this->plan.outgoingMessages[messageIndex].count;
+    }
+}
+
+template <typename Value>
+bool PersistentMessageBuffer<Value>::unpackNextMessage(const int sourceRank, const bool blocking) {
+    const vector<uint32_t> &pending = pendingMessages[sourceRank];
+    size_t &next = nextPendingMessage[sourceRank];
+
+    // Messages that have already been unpacked by receiveAny are skipped
+    while (next < pending.size() && unpacked[pending[next]]) next++;
+    assert(next < pending.size());
+
+    const uint32_t messageIndex = pending[next];
+    if (blocking) {
+        MPI_Wait(&receiveRequests[messageIndex], MPI_STATUS_IGNORE);
+    } else {
+        int flag;
+        MPI_Test(&receiveRequests[messageIndex], &flag, MPI_STATUS_IGNORE);
+        if (!flag) return false;
+    }
+    next++;
+
+    unpackMessage(messageIndex);
+    return true;
+}
+
+template <typename Value>
+void PersistentMessageBuffer<Value>::unpackMessage(const uint32_t messageIndex) {
+    assert(!unpacked[messageIndex]);
+    unpacked[messageIndex] = true;
+    this->awaitedNumbers++;
+
+    const PlanMessage &m = this->plan.incomingMessages[messageIndex];
+    for (uint32_t i = m.first; i < m.first + m.count; i++) {
+#ifdef CHECK_MESSAGE_INDICES
+        if (receiveBuffer[i].index != this->plan.incomingIndices[i]) {
+            throw logic_error("Received index "s + to_string(receiveBuffer[i].index) + " instead of "
+                    + to_string(this->plan.incomingIndices[i]) + " from rank " + to_string(m.peer));
+        }
+        this->deliver(this->plan.incomingPositions[i], receiveBuffer[i].value);
+#else
+        this->deliver(this->plan.incomingPositions[i], receiveBuffer[i]);
+#endif
+    }
+}
+
+template <typename Value>
+bool PersistentMessageBuffer<Value>::receiveAny(const bool blocking) {
+    if (receiveRequests.empty()) return false;
+
+    // Completed persistent requests become inactive and are ignored by Waitany and Testsome
+    int completed;
+    if (blocking) {
+        MPI_Waitany(receiveRequests.size(), &receiveRequests[0], &completedReceives[0],
+                &receiveStatuses[0]);
+        completed = (completedReceives[0] == MPI_UNDEFINED) ? 0 : 1;
+    } else {
+        MPI_Testsome(receiveRequests.size(), &receiveRequests[0], &completed, &completedReceives[0],
+                &receiveStatuses[0]);
+        if (completed == MPI_UNDEFINED) completed = 0;
+    }
+
+    for (int i = 0; i < completed; i++) {
+        unpackMessage(completedReceives[i]);
+    }
+
+    return completed > 0;
+}
+
+template <typename Value>
+bool PersistentMessageBuffer<Value>::receiveAvailable() {
+    /* Nothing is held back on this side, a sender starts each message with MPI_Start as soon as put
+     * has filled its last entry, so this is only a nonblocking receiveAny */
+    return receiveAny(false);
+}
+
+template <typename Value>
+const Value PersistentMessageBuffer<Value>::get(const int sourceRank, const uint32_t position) {
+    // Unpack the messages of that source in the order they are sent until the number shows up
+    Value result;
+    while (!this->take(position, result)) {
+        unpackNextMessage(sourceRank, true);
+    }
+
+    return result;
+}
+
+template <typename Value>
+bool PersistentMessageBuffer<Value>::tryGet(const int sourceRank, const uint32_t position, Value &value) {
+    while (!this->take(position, value)) {
+        if (!unpackNextMessage(sourceRank, false)) return false;
+    }
+
+    return true;
+}
+
+template <typename Value>
+bool PersistentMessageBuffer<Value>::test() {
+    int completed = true;
+    if (!sendRequests.empty()) {
+        MPI_Testall(sendRequests.size(), &sendRequests[0], &completed, MPI_STATUSES_IGNORE);
+    }
+    return completed;
+}
+
+template <typename Value>
+SharedMemoryMessageBuffer<Value>::SharedMemoryMessageBuffer(MPI_Comm comm, const ReductionPlan &plan)
+    : MessageBuffer<Value>(comm, plan),
+      generation(0),
+      polled(plan.remoteValueCount)
+{
+    int size;
+    MPI_Comm_size(comm, &size);
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &nodeComm);
+
+    MPI_Group group, nodeGroup;
+    MPI_Comm_group(comm, &group);
+    MPI_Comm_group(nodeComm, &nodeGroup);
+    vector<int> ranks(size);
+    std::iota(ranks.begin(), ranks.end(), 0);
+    nodeRanks.resize(size);
+    MPI_Group_translate_ranks(group, size, &ranks[0], nodeGroup, &nodeRanks[0]);
+    MPI_Group_free(&group);
+    MPI_Group_free(&nodeGroup);
+
+    MPI_Win_allocate_shared(sizeof(WindowSlot<Value>) * plan.remoteValueCount, sizeof(WindowSlot<Value>),
+            MPI_INFO_NULL, nodeComm, static_cast<void *>(&slots), &window);
+    std::fill(slots, slots + plan.remoteValueCount, WindowSlot<Value> { Value {}, 0, 0 });
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, window);
+
+    for (const PlanMessage &m : plan.incomingMessages) {
+        if (isNodeLocal(m.peer)) {
+            this->expectedValues.erase(m.peer);
+            sharedPositions.insert(sharedPositions.end(), &plan.incomingPositions[m.first],
+                    &plan.incomingPositions[m.first] + m.count);
+        }
+    }
+
+    const vector<uint32_t> positions = this->targetPositions();
+    for (const PlanSubtree &subtree : plan.subtrees) {
+        if (subtree.targetRank < 0) continue;
+
+        const uint32_t slot = positions[outgoingIndices.size()];
+        outgoingIndices.push_back(subtree.index);
+
+        if (isNodeLocal(subtree.targetRank)) {
+            MPI_Aint windowSize;
+            int displacementUnit;
+            WindowSlot<Value> *targetSlots;
+            MPI_Win_shared_query(window, nodeRanks[subtree.targetRank], &windowSize, &displacementUnit,
+                    static_cast<void *>(&targetSlots));
+            outgoingSlots.push_back(targetSlots + slot);
+        } else {
+            outgoingSlots.push_back(nullptr);
+        }
+    }
+
+    // All slots must be initialized before anyone publishes a value
+    MPI_Barrier(nodeComm);
+}
+
+template <typename Value>
+SharedMemoryMessageBuffer<Value>::~SharedMemoryMessageBuffer() {
+    int finalized;
+    MPI_Finalized(&finalized);
+    if (finalized) return;
+
+    MPI_Win_unlock_all(window);
+    MPI_Win_free(&window);
+    MPI_Comm_free(&nodeComm);
+}
+
+template <typename Value>
+bool SharedMemoryMessageBuffer<Value>::isNodeLocal(const int rank) const {
+    return nodeRanks[rank] != MPI_UNDEFINED;
+}
+
+template <typename Value>
+void SharedMemoryMessageBuffer<Value>::startReduction() {
+    MessageBuffer<Value>::startReduction();
+    std::fill(polled.begin(), polled.end(), false);
+    generation++;
+}
+
+template <typename Value>
+void SharedMemoryMessageBuffer<Value>::put(const int targetRank, const uint64_t index, const Value value) {
+    const auto it = std::lower_bound(outgoingIndices.begin(), outgoingIndices.end(), index);
+    assert(it != outgoingIndices.end() && *it == index);
+    WindowSlot<Value> *slot = outgoingSlots[it - outgoingIndices.begin()];
+
+    if (slot == nullptr) {
+        MessageBuffer<Value>::put(targetRank, index, value);
+        return;
+    }
+
+    // The receiver may still be in the previous reduction if no broadcast separates the two
+    std::atomic_ref<uint64_t> consumed(slot->consumed);
+    while (consumed.load(std::memory_order_acquire) + 1 < generation) {
+        std::this_thread::yield();
+    }
+
+    /* Shared windows use the unified memory model, so the release store orders the value before the
+     * generation for the polling receiver */
+    slot->value = value;
+    std::atomic_ref<uint64_t>(slot->generation).store(generation, std::memory_order_release);
+}
+
+template <typename Value>
+bool SharedMemoryMessageBuffer<Value>::poll(const uint32_t position) {
+    if (polled[position]) return true;
+
+    WindowSlot<Value> &slot = slots[position];
+    if (std::atomic_ref<uint64_t>(slot.generation).load(std::memory_order_acquire) != generation) {
+        return false;
+    }
+
+    this->deliver(position, slot.value);
+    std::atomic_ref<uint64_t>(slot.consumed).store(generation, std::memory_order_release);
+    polled[position] = true;
+    return true;
+}
+
+template <typename Value>
+const Value SharedMemoryMessageBuffer<Value>::get(const int sourceRank, const uint32_t position) {
+    if (!isNodeLocal(sourceRank)) {
+        return MessageBuffer<Value>::get(sourceRank, position);
+    }
+
+    if (!poll(position)) {
+        // Make sure no one is waiting for our results, then spin until the value is published
+        this->flush();
+        while (!poll(position)) {
+            std::this_thread::yield();
+        }
+    }
+
+    Value value {};
+    this->take(position, value);
+    return value;
+}
+
+template <typename Value>
+bool SharedMemoryMessageBuffer<Value>::tryGet(const int sourceRank, const uint32_t position, Value &value) {
+    if (!isNodeLocal(sourceRank)) {
+        return MessageBuffer<Value>::tryGet(sourceRank, position, value);
+    }
+
+    if (!poll(position)) {
+        this->flush();
+        return false;
+    }
+
+    return this->take(position, value);
+}
+
+template <typename Value>
+bool SharedMemoryMessageBuffer<Value>::receiveAny(const bool blocking) {
+    this->flush();
+
+    while (true) {
+        const bool received = receiveAvailable();
+
+        if (received || !blocking) {
+            return received;
+        }
+        std::this_thread::yield();
+    }
+}
+
+template <typename Value>
+bool SharedMemoryMessageBuffer<Value>::receiveAvailable() {
+    bool received = false;
+    for (const uint32_t position : sharedPositions) {
+        if (!polled[position] && poll(position)) {
+            received = true;
+        }
+    }
+
+    // Values from other nodes still arrive as messages
+    if (MessageBuffer<Value>::receiveAvailable()) {
+        received = true;
+    }
+
+    return received;
+}
+
+template <typename Value>
+OneSidedMessageBuffer<Value>::OneSidedMessageBuffer(MPI_Comm comm, const ReductionPlan &plan)
+    : MessageBuffer<Value>(comm, plan),
+      generation(0),
+      outgoingPositions(this->targetPositions()),
+      polled(plan.remoteValueCount)
+{
+    MPI_Comm_rank(comm, &rank);
+    // Displacements are given in bytes, so the fields of a slot can be addressed
+    MPI_Win_allocate(sizeof(WindowSlot<Value>) * plan.remoteValueCount, 1, MPI_INFO_NULL,
+            comm, static_cast<void *>(&slots), &window);
+    std::fill(slots, slots + plan.remoteValueCount, WindowSlot<Value> { Value {}, 0, 0 });
+
+    for (const PlanSubtree &subtree : plan.subtrees) {
+        if (subtree.targetRank >= 0) {
+            outgoingIndices.push_back(subtree.index);
+        }
+    }
+
+    // All slots must be initialized before anyone writes into them
+    MPI_Barrier(comm);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, window);
+}
+
+template <typename Value>
+OneSidedMessageBuffer<Value>::~OneSidedMessageBuffer() {
+    int finalized;
+    MPI_Finalized(&finalized);
+    if (finalized) return;
+
+    MPI_Win_unlock_all(window);
+    MPI_Win_free(&window);
+}
+
+template <typename Value>
+void OneSidedMessageBuffer<Value>::startReduction() {
+    MessageBuffer<Value>::startReduction();
+    std::fill(polled.begin(), polled.end(), false);
+    generation++;
+}
+
+template <typename Value>
+void OneSidedMessageBuffer<Value>::put(const int targetRank, const uint64_t index, const Value value) {
+    const auto it = std::lower_bound(outgoingIndices.begin(), outgoingIndices.end(), index);
+    assert(it != outgoingIndices.end() && *it == index);
+    typedef WindowSlot<Value> Slot;
+    const MPI_Aint slot = outgoingPositions[it - outgoingIndices.begin()];
+
+    // The receiver may still be in the previous reduction if no broadcast separates the two
+    if (generation > 1) {
+        uint64_t consumed;
+        do {
+            MPI_Fetch_and_op(nullptr, &consumed, MPI_UINT64_T, targetRank,
+                    slot * sizeof(Slot) + offsetof(Slot, consumed), MPI_NO_OP, window);
+            MPI_Win_flush(targetRank, window);
+        } while (consumed + 1 < generation);
+    }
+
+    /* Puts are not ordered, so the value must be complete at the target before the generation
+     * tells the receiver that it is there. The generation is polled while it is written, which
+     * requires an atomic operation */
+    MPI_Put(&value, sizeof(Value), MPI_BYTE, targetRank, slot * sizeof(Slot) + offsetof(Slot, value),
+            sizeof(Value), MPI_BYTE, window);
+    MPI_Win_flush(targetRank, window);
+    MPI_Accumulate(&generation, 1, MPI_UINT64_T, targetRank,
+            slot * sizeof(Slot) + offsetof(Slot, generation), 1, MPI_UINT64_T, MPI_REPLACE,
+            window);
+    MPI_Win_flush(targetRank, window);
+
+    this->sentSummands++;
+}
+
+template <typename Value>
+bool OneSidedMessageBuffer<Value>::poll(const uint32_t position) {
+    if (polled[position]) return true;
+
+    /* Plain loads may not observe puts that have not been processed yet, reading through MPI also
+     * makes progress on them */
+    typedef WindowSlot<Value> Slot;
+    const MPI_Aint slot = position * sizeof(Slot);
+    uint64_t slotGeneration;
+    MPI_Fetch_and_op(nullptr, &slotGeneration, MPI_UINT64_T, rank, slot + offsetof(Slot, generation),
+            MPI_NO_OP, window);
+    MPI_Win_flush(rank, window);
+    if (slotGeneration != generation) {
+        return false;
+    }
+
+    // The sender does not touch the value again before we mark it as consumed
+    Value value;
+    MPI_Get(&value, sizeof(Value), MPI_BYTE, rank, slot + offsetof(Slot, value), sizeof(Value), MPI_BYTE,
+            window);
+    MPI_Win_flush(rank, window);
+
+    // Only now the sender may overwrite the slot
+    MPI_Accumulate(&generation, 1, MPI_UINT64_T, rank, slot + offsetof(Slot, consumed), 1, MPI_UINT64_T,
+            MPI_REPLACE, window);
+    MPI_Win_flush(rank, window);
+
+    this->deliver(position, value);
+    polled[position] = true;
+    return true;
+}
+
+template <typename Value>
+const Value OneSidedMessageBuffer<Value>::get(const int sourceRank, const uint32_t position) {
+    while (!poll(position)) {
+        std::this_thread::yield();
+    }
+
+    Value value {};
+    this->take(position, value);
+    return value;
+}
+
+template <typename Value>
+bool OneSidedMessageBuffer<Value>::tryGet(const int sourceRank, const uint32_t position, Value &value) {
+    if (!poll(position)) {
+        return false;
+    }
+
+    return this->take(position, value);
+}
+
+template <typename Value>
+bool OneSidedMessageBuffer<Value>::receiveAny(const bool blocking) {
+    while (true) {
+        bool received = false;
+        for (uint32_t position = 0; position < this->plan.remoteValueCount; position++) {
+            if (!polled[position] && poll(position)) {
+                received = true;
+            }
+        }
+
+        if (received || !blocking) {
+            return received;
+        }
+        std::this_thread::yield();
+    }
+}
+
+template <typename Value>
+bool OneSidedMessageBuffer<Value>::receiveAvailable() {
+    // Values are published by put directly, there is nothing to flush
+    return receiveAny(false);
+}
+
+template <typename Value>
+NeighborhoodMessageBuffer<Value>::NeighborhoodMessageBuffer(MPI_Comm comm, const ReductionPlan &plan)
+    : MessageBuffer<Value>(comm, plan),
+      sendBuffer(plan.subtrees.size()),
+      receiveBuffer(plan.incomingIndices.size()),
+      exchangeStarted(false),
+      exchangeRequest(MPI_REQUEST_NULL)
+{
+    MPI_Allreduce(&plan.roundCount, &roundCount, 1, MPI_UINT32_T, MPI_MAX, comm);
+
+    // Incoming messages are ordered by their source
+    for (const PlanMessage &m : plan.incomingMessages) {
+        if (sources.empty() || sources.back() != m.peer) {
+            sources.push_back(m.peer);
+        }
+    }
+    for (const PlanMessage &m : plan.outgoingMessages) {
+        destinations.push_back(m.peer);
+    }
+    std::sort(destinations.begin(), destinations.end());
+    destinations.erase(std::unique(destinations.begin(), destinations.end()), destinations.end());
+
+    MPI_Dist_graph_create_adjacent(comm, sources.size(), sources.data(), MPI_UNWEIGHTED,
+            destinations.size(), destinations.data(), MPI_UNWEIGHTED, MPI_INFO_NULL, 0, &graphComm);
+    MPI_Type_contiguous(sizeof(Value), MPI_BYTE, &valueType);
+    MPI_Type_commit(&valueType);
+
+    /* The values of a round are ordered by neighbor and then by index on both sides, so they can be
+     * sent without their index */
+    const size_t d = destinations.size();
+    sendCounts.resize(roundCount * d);
+    sendDisplacements.resize(roundCount * d);
+    for (const PlanSubtree &subtree : plan.subtrees) {
+        if (subtree.targetRank < 0) continue;
+
+        const size_t neighbor = std::lower_bound(destinations.begin(), destinations.end(),
+                subtree.targetRank) - destinations.begin();
+        outgoingIndices.push_back(subtree.index);
+        sendSlots.push_back(subtree.round * d + neighbor);
+        sendCounts[subtree.round * d + neighbor]++;
+    }
+    std::exclusive_scan(sendCounts.begin(), sendCounts.end(), sendDisplacements.begin(), 0);
+
+    vector<int> filled(sendDisplacements);
+    for (uint32_t &slot : sendSlots) {
+        slot = filled[slot]++;
+    }
+
+    const size_t s = sources.size();
+    receiveCounts.resize(roundCount * s);
+    receiveDisplacements.resize(roundCount * s);
+    vector<uint32_t> receiveSlots;
+    for (size_t i = 0; i < plan.incomingIndices.size(); i++) {
+        const int source = plan.incomingMessages[std::upper_bound(plan.incomingMessages.begin(),
+                plan.incomingMessages.end(), i, [] (const size_t entry, const PlanMessage &m) {
+                    return entry < m.first;
+                }) - plan.incomingMessages.begin() - 1].peer;
+        const size_t neighbor = std::lower_bound(sources.begin(), sources.end(), source) - sources.begin();
+        receiveSlots.push_back(plan.incomingRounds[i] * s + neighbor);
+        receiveCounts[plan.incomingRounds[i] * s + neighbor]++;
+    }
+    std::exclusive_scan(receiveCounts.begin(), receiveCounts.end(), receiveDisplacements.begin(), 0);
+
+    filled = receiveDisplacements;
+    receivedPositions.resize(plan.incomingIndices.size());
+    for (size_t i = 0; i < plan.incomingIndices.size(); i++) {
+        receivedPositions[filled[receiveSlots[i]]++] = plan.incomingPositions[i];
+    }
+}
+
+template <typename Value>
+NeighborhoodMessageBuffer<Value>::~NeighborhoodMessageBuffer() {
+    int finalized;
+    MPI_Finalized(&finalized);
+    if (finalized) return;
+
+    MPI_Type_free(&valueType);
+    MPI_Comm_free(&graphComm);
+}
+
+template <typename Value>
+void NeighborhoodMessageBuffer<Value>::startReduction() {
+    MessageBuffer<Value>::startReduction();
+    assert(!exchangeStarted);
+}
+
+template <typename Value>
+uint32_t NeighborhoodMessageBuffer<Value>::rounds() const {
+    return roundCount;
+}
+
+template <typename Value>
+void NeighborhoodMessageBuffer<Value>::put(const int targetRank, const uint64_t index, const Value value) {
+    const auto it = std::lower_bound(outgoingIndices.begin(), outgoingIndices.end(), index);
+    assert(it != outgoingIndices.end() && *it == index);
 
+    sendBuffer[sendSlots[it - outgoingIndices.begin()]] = value;
+    this->sentSummands++;
+}
+
+template <typename Value>
+const Value NeighborhoodMessageBuffer<Value>::get(const int sourceRank, const uint32_t position) {
+    Value value {};
+    if (!this->take(position, value)) {
+        throw logic_error("Number "s + to_string(this->plan.remoteIndices[position]) + " from rank " + to_string(sourceRank)
+                + " has not been exchanged in an earlier round");
     }
 
+    return value;
 }
 
+template <typename Value>
+bool NeighborhoodMessageBuffer<Value>::tryGet(const int sourceRank, const uint32_t position, Value &value) {
+    return this->take(position, value);
+}
+
+template <typename Value>
+bool NeighborhoodMessageBuffer<Value>::exchange(const uint32_t round, const bool blocking) {
+    const size_t d = destinations.size();
+    const size_t s = sources.size();
+
+    if (!exchangeStarted) {
+        MPI_Ineighbor_alltoallv(sendBuffer.data(), sendCounts.data() + round * d,
+                sendDisplacements.data() + round * d, valueType,
+                receiveBuffer.data(), receiveCounts.data() + round * s,
+                receiveDisplacements.data() + round * s, valueType, graphComm, &exchangeRequest);
+        exchangeStarted = true;
+
+        for (size_t i = 0; i < d; i++) {
+            if (sendCounts[round * d + i] > 0) this->sentMessages++;
+        }
+    }
+
+    if (blocking) {
+        MPI_Wait(&exchangeRequest, MPI_STATUS_IGNORE);
+    } else {
+        int completed;
+        MPI_Test(&exchangeRequest, &completed, MPI_STATUS_IGNORE);
+        if (!completed) return false;
+    }
+    exchangeStarted = false;
+
+    for (size_t i = 0; i < s; i++) {
+        const int first = receiveDisplacements[round * s + i];
+        for (int slot = first; slot < first + receiveCounts[round * s + i]; slot++) {
+            this->deliver(receivedPositions[slot], receiveBuffer[slot]);
+        }
+    }
+
+    return true;
+}
+
+
+template <typename Operator>
+TreeAccumulationRequest<Operator>::TreeAccumulationRequest(TreeReduction<Operator> &tree)
+    : tree(tree),
+      reduced(false),
+      broadcastStarted(false),
+      completed(false),
+      broadcastRequest(MPI_REQUEST_NULL),
+      result(0.0) {
+}
+
+template <typename Operator>
+bool TreeAccumulationRequest<Operator>::test() {
+    if (completed) return true;
+
+    if (!reduced) {
+        if (!tree.progressPlan(false) || !tree.messageBuffer->test()) return false;
+        reduced = true;
+    }
+
+    if (tree.finalization == Finalization::BUTTERFLY) {
+        if (!tree.progressButterfly(false)) return false;
+        result = Operator::result(tree.planResult);
+        completed = true;
+        return true;
+    }
+
+    if (!broadcastStarted) {
+        result = Operator::result(tree.planResult);
+        MPI_Ibcast(&result, 1, MPI_DOUBLE, tree.ROOT_RANK, tree.comm, &broadcastRequest);
+        broadcastStarted = true;
+    }
+
+    int flag;
+    MPI_Test(&broadcastRequest, &flag, MPI_STATUS_IGNORE);
+    completed = flag;
+
+    return completed;
+}
+
+template <typename Operator>
+double TreeAccumulationRequest<Operator>::wait() {
+    if (completed) return result;
+
+    if (!reduced) {
+        tree.progressPlan(true);
+        tree.messageBuffer->wait();
+        reduced = true;
+    }
+
+    if (tree.finalization == Finalization::BUTTERFLY) {
+        tree.progressButterfly(true);
+        result = Operator::result(tree.planResult);
+        completed = true;
+        return result;
+    }
 
-BinaryTreeSummation::BinaryTreeSummation(uint64_t rank, vector<int> &n_summands, MPI_Comm comm)
-    : SummationStrategy(rank, n_summands, comm),
+    if (!broadcastStarted) {
+        result = Operator::result(tree.planResult);
+        MPI_Ibcast(&result, 1, MPI_DOUBLE, tree.ROOT_RANK, tree.comm, &broadcastRequest);
+        broadcastStarted = true;
+    }
+
+    MPI_Wait(&broadcastRequest, MPI_STATUS_IGNORE);
+    completed = true;
+
+    return result;
+}
+
+
+template <typename Operator>
+TreeReduction<Operator>::TreeReduction(uint64_t rank, vector<int> &n_summands, MPI_Comm comm,
+        TransportMode transportMode, Finalization finalization, SendSchedule sendSchedule)
+    : SummationStrategy(rank, n_summands, Util::duplicate(comm)),
       size(n_summands[rank]),
       begin (startIndex[rank]),
       end (begin + size),
-      rankIntersectingSummands(calculateRankIntersectingSummands()),
-      nonResidualRanks(clusterSize - (globalSize) % clusterSize),
-      fairShare(floor(globalSize / clusterSize)),
-      splitIndex(nonResidualRanks * fairShare),
-      acquisitionDuration(std::chrono::duration<double>::zero()),
-      acquisitionCount(0L),
-      messageBuffer(comm)
+      finalization(finalization),
+      // Fresh messages carry their indices, so only the other transports need the incoming layout
+      plan(rank, n_summands, transportMode != TransportMode::ISEND, finalization == Finalization::BUTTERFLY,
+              sendSchedule),
+      butterflyDistance(clusterSize),
+      butterflyStarted(false),
+      planCursors(plan.subtrees.size()),
+      blockValues(plan.operations.size()),
+      scheduling(Scheduling::IN_ORDER),
+      transportMode(transportMode),
+      threads(1),
+      kernel(&TreeKernels::best()),
+      neighborhoodBuffer(nullptr)
 {
-    /* Initialize start indices map */
-    int startIndex = 0;
-    int rankNumber = 0;
-    for (const int& n : n_summands) {
-        startIndices[startIndex] = rankNumber++;
-        startIndex += n;
+    // From here on, comm is the communicator of the caller and this->comm our duplicate
+    if (transportMode == TransportMode::PERSISTENT) {
+        messageBuffer = std::make_unique<PersistentMessageBuffer<value_type>>(this->comm, plan);
+    } else if (transportMode == TransportMode::SHARED) {
+        messageBuffer = std::make_unique<SharedMemoryMessageBuffer<value_type>>(this->comm, plan);
+    } else if (transportMode == TransportMode::RMA) {
+        messageBuffer = std::make_unique<OneSidedMessageBuffer<value_type>>(this->comm, plan);
+    } else if (transportMode == TransportMode::NEIGHBORHOOD) {
+        auto buffer = std::make_unique<NeighborhoodMessageBuffer<value_type>>(this->comm, plan);
+        neighborhoodBuffer = buffer.get();
+        messageBuffer = std::move(buffer);
+    } else {
+        messageBuffer = std::make_unique<MessageBuffer<value_type>>(this->comm, plan);
     }
-    // guardian element
-    startIndices[startIndex] = rankNumber;
 
-    if (accumulationBuffer.size() < (size  - 8)) {
-        accumulationBuffer.resize(size);
+    if (finalization == Finalization::BUTTERFLY) {
+        // Every rank knows the spine of the root and which rank computes each of its inputs
+        const int rootRank = plan.rankFromIndex(0);
+        const ReductionPlan rootPlan(rootRank, n_summands, false);
+        rootSubtree = rootPlan.subtrees[0];
+        rootOperations = rootPlan.operations;
+
+        rootInputOwners.push_back(rootRank);
+        for (const PlanOperation &op : rootOperations) {
+            rootInputOwners.push_back(op.type == PlanOperation::LOCAL_BLOCK ? rootRank : op.rank);
+        }
+        rootInputs.resize(rootInputOwners.size());
+        butterflySendBuffer.resize(rootInputs.size());
+        butterflyReceiveBuffer.resize(rootInputs.size());
     }
 
     int initialized;
     MPI_Initialized(&initialized);
     if (initialized) {
         int c_size;
-        MPI_Comm_size(comm, &c_size);
+        MPI_Comm_size(this->comm, &c_size);
         assert(c_size == n_summands.size());
     }
+}
+
+template <typename Operator>
+TreeReduction<Operator>::~TreeReduction() {
+    // Both use the communicator
+    progressThread.reset();
+    messageBuffer.reset();
+
+    int initialized, finalized;
+    MPI_Initialized(&initialized);
+    MPI_Finalized(&finalized);
+    if (initialized && !finalized) {
+        MPI_Comm duplicate = comm;
+        MPI_Comm_free(&duplicate);
+    }
+}
+
+BinaryTreeSummation::BinaryTreeSummation(uint64_t rank, vector<int> &n_summands, MPI_Comm comm,
+        TransportMode transportMode, Finalization finalization, SendSchedule sendSchedule)
+    : TreeReduction<SumOperator>(rank, n_summands, comm, transportMode, finalization, sendSchedule),
+      rankIntersectingSummands(calculateRankIntersectingSummands()),
+      nonResidualRanks(clusterSize - (globalSize) % clusterSize),
+      fairShare(floor(globalSize / clusterSize)),
+      splitIndex(nonResidualRanks * fairShare),
+      acquisitionDuration(std::chrono::duration<double>::zero()),
+      acquisitionCount(0L)
+{
+    /* Initialize start indices map */
+    int startIndex = 0;
+    int rankNumber = 0;
+    for (const int& n : n_summands) {
+        startIndices[startIndex] = rankNumber++;
+        startIndex += n;
+    }
+    // guardian element
+    startIndices[startIndex] = rankNumber;
 
 #ifdef DEBUG_OUTPUT_TREE
     printf("Rank %lu has %lu summands, starting from index %lu to %lu\n", rank, size, begin, end);
@@ -196,9 +1187,6 @@ BinaryTreeSummation::BinaryTreeSummation(uint64_t rank, vector<int> &n_summands,
 #endif
 }
 
-// Initialize accumulation buffer
-vector<double, Util::AlignedAllocator<double>> BinaryTreeSummation::accumulationBuffer(1024);
-
 BinaryTreeSummation::~BinaryTreeSummation() {
 #ifdef ENABLE_INSTRUMENTATION
     cout << "Rank " << rank << " avg. acquisition time: "
@@ -251,7 +1239,7 @@ const double BinaryTreeSummation::acquireNumber(const uint64_t index) {
     }
 
     // Otherwise, receive it
-    const double result = messageBuffer.get(rankFromIndex(index), index);
+    const double result = messageBuffer->get(rankFromIndex(index), plan.remotePosition(index));
 
     return result;
 }
@@ -279,30 +1267,619 @@ vector<uint64_t> BinaryTreeSummation::calculateRankIntersectingSummands(void) co
     return result;
 }
 
-/* Sum all numbers. Will return the total sum on rank 0
+/* Reduce all numbers. Will return the result on all ranks
     */
-double BinaryTreeSummation::accumulate(void) {
-    for (auto summand : rankIntersectingSummands) {
-        if (subtree_size(summand) > 16) {
-            // If we are about to do some considerable amount of work, make sure
-            // the send buffer is empty so noone is waiting for our results
-            messageBuffer.flush();
+template <typename Operator>
+double TreeReduction<Operator>::accumulate(void) {
+    double result = replayPlan();
+    if (finalization == Finalization::BUTTERFLY) {
+        return result;
+    }
+
+    MPI_Bcast(&result, 1, MPI_DOUBLE,
+              ROOT_RANK, comm);
+
+    return result;
+}
+
+template <typename Operator>
+double TreeReduction<Operator>::accumulate_to(const int root) {
+    if (finalization == Finalization::BUTTERFLY) {
+        startPlan();
+        progressPlan(true);
+        messageBuffer->wait();
+
+        gatherRootInputs(root);
+        return Operator::result(planResult);
+    }
+
+    double result = replayPlan();
+    if (root != ROOT_RANK) {
+        if (rank == ROOT_RANK) {
+            MPI_Send(&result, 1, MPI_DOUBLE, root, RESULT_MPI_TAG, comm);
+        } else if (rank == root) {
+            MPI_Recv(&result, 1, MPI_DOUBLE, ROOT_RANK, RESULT_MPI_TAG, comm, MPI_STATUS_IGNORE);
+        }
+    }
+
+    return result;
+}
+
+/* Append a subtree and merge it with its sibling as long as that completes their parent, so the
+ * blocks stay the largest complete subtrees. Both siblings are already summed in tree order, hence
+ * the parent is too */
+static void append_scan_block(ScanBlocks &s, const uint64_t index, const int level, const double value) {
+    assert(s.count < sizeof(s.blocks) / sizeof(s.blocks[0]));
+    s.blocks[s.count++] = { index, level, value };
+
+    while (s.count >= 2) {
+        ScanBlocks::Block &left = s.blocks[s.count - 2];
+        const ScanBlocks::Block &right = s.blocks[s.count - 1];
+        const uint64_t size = 1UL << left.level;
+
+        if (left.level != right.level || left.index % (2 * size) != 0 || right.index != left.index + size) {
+            break;
         }
 
-        double result = accumulate(summand);
+        left.value = left.value + right.value;
+        left.level++;
+        s.count--;
+    }
+}
+
+/* Sum of a prefix from its subtrees. Each subtree is the left sibling of the remaining ones, like
+ * the local blocks on a spine, so they are added from the right */
+static double fold_scan_blocks(const ScanBlocks &s) {
+    if (s.count == 0) return 0.0;
 
-        messageBuffer.put(rankFromIndex(parent(summand)), summand, result);
+    double acc = s.blocks[s.count - 1].value;
+    for (int i = static_cast<int>(s.count) - 2; i >= 0; i--) {
+        acc = s.blocks[i].value + acc;
     }
-    messageBuffer.flush();
-    messageBuffer.wait();
 
-    double result = (rank == ROOT_RANK) ? accumulate(0) : 0.0;
-    MPI_Bcast(&result, 1, MPI_DOUBLE,
-              ROOT_RANK, comm);
+    return acc;
+}
+
+/* User-defined reduction of MPI_Exscan, inout holds the blocks of the range right after those of in */
+static void merge_scan_blocks(void *in, void *inout, int *len, MPI_Datatype *datatype) {
+    const ScanBlocks *left = static_cast<const ScanBlocks *>(in);
+    ScanBlocks *right = static_cast<ScanBlocks *>(inout);
+
+    for (int i = 0; i < *len; i++) {
+        ScanBlocks merged = left[i];
+        for (uint32_t j = 0; j < right[i].count; j++) {
+            const ScanBlocks::Block &b = right[i].blocks[j];
+            append_scan_block(merged, b.index, b.level, b.value);
+        }
+        right[i] = merged;
+    }
+}
+
+/* Blocks are sent as raw bytes and merged in rank order, so the operation is not commutative */
+static void create_scan_blocks_op(MPI_Datatype &type, MPI_Op &op) {
+    MPI_Type_contiguous(sizeof(ScanBlocks), MPI_BYTE, &type);
+    MPI_Type_commit(&type);
+    MPI_Op_create(merge_scan_blocks, 0, &op);
+}
+
+ScanBlocks BinaryTreeSummation::localScanBlocks(const uint64_t first, const uint64_t last, const uint64_t origin) {
+    assert(begin <= first && last <= end);
+
+    ScanBlocks local;
+    local.count = 0;
+
+    uint64_t index = first;
+    while (index < last) {
+        // Largest subtree that starts at index and ends within the range
+        int level = (index == origin) ? 63 : __builtin_ctzl(index - origin);
+        while ((1UL << level) > last - index) {
+            level--;
+        }
+
+        append_scan_block(local, index - origin, level, accumulate_block(index, level));
+        index += 1UL << level;
+    }
+
+    return local;
+}
+
+ScanBlocks BinaryTreeSummation::precedingScanBlocks(const ScanBlocks &local) const {
+    ScanBlocks preceding;
+    preceding.count = 0;
+
+    if (clusterSize == 1) {
+        return preceding;
+    }
+
+    MPI_Datatype type;
+    MPI_Op op;
+    create_scan_blocks_op(type, op);
+
+    MPI_Exscan(&local, &preceding, 1, type, op, comm);
+
+    MPI_Op_free(&op);
+    MPI_Type_free(&type);
+
+    // The receive buffer of the first rank is undefined
+    if (rank == 0) {
+        preceding.count = 0;
+    }
+
+    return preceding;
+}
+
+vector<double> BinaryTreeSummation::scan(const bool inclusive) {
+    ScanBlocks blocks = precedingScanBlocks(localScanBlocks(begin, end));
+
+    vector<double> prefixes(end - begin);
+    for (uint64_t i = begin; i < end; i++) {
+        if (!inclusive) {
+            prefixes[i - begin] = fold_scan_blocks(blocks);
+        }
+
+        append_scan_block(blocks, i, 0, summands[i - begin]);
+
+        if (inclusive) {
+            prefixes[i - begin] = fold_scan_blocks(blocks);
+        }
+    }
+
+    return prefixes;
+}
+
+double BinaryTreeSummation::rankPrefix(const bool inclusive) {
+    const ScanBlocks local = localScanBlocks(begin, end);
+    ScanBlocks blocks = precedingScanBlocks(local);
+
+    if (inclusive) {
+        for (uint32_t j = 0; j < local.count; j++) {
+            append_scan_block(blocks, local.blocks[j].index, local.blocks[j].level, local.blocks[j].value);
+        }
+    }
+
+    return fold_scan_blocks(blocks);
+}
+
+SegmentSums BinaryTreeSummation::accumulate_segments(const vector<uint64_t> &boundaries) {
+    if (boundaries.empty() || !std::is_sorted(boundaries.begin(), boundaries.end()) || boundaries.back() > globalSize) {
+        throw logic_error("Segment boundaries must be ascending indices up to "s + to_string(globalSize));
+    }
+
+    const size_t segmentCount = boundaries.size() - 1;
+    SegmentSums result { vector<double>(segmentCount, 0.0), 0.0 };
+
+    /* A segment within a single rank is summed there and gathered. Segments spanning several ranks,
+     * as well as the whole index space for the total, are decomposed into subtrees by every rank
+     * involved and merged in rank order by a single allreduce */
+    vector<ScanBlocks> merged(1);
+    merged[0] = localScanBlocks(begin, end);
+
+    vector<int> owner(segmentCount, -1);
+    vector<uint32_t> mergedSegments;
+    vector<int> localCounts(clusterSize, 0);
+    vector<double> localSums;
+
+    for (size_t i = 0; i < segmentCount; i++) {
+        const uint64_t first = boundaries[i];
+        const uint64_t last = boundaries[i + 1];
+        if (first == last) continue;
+
+        const int firstRank = rankFromIndex(first);
+        if (firstRank == static_cast<int>(rankFromIndex(last - 1))) {
+            owner[i] = firstRank;
+            localCounts[firstRank]++;
+
+            if (firstRank == rank) {
+                const ScanBlocks blocks = localScanBlocks(first, last, first);
+                localSums.push_back(fold_scan_blocks(blocks));
+            }
+        } else {
+            ScanBlocks piece;
+            piece.count = 0;
+            if (first < end && last > begin) {
+                piece = localScanBlocks(std::max(first, begin), std::min(last, end), first);
+            }
+
+            merged.push_back(piece);
+            mergedSegments.push_back(i);
+        }
+    }
+
+    vector<double> gatheredSums(std::accumulate(localCounts.begin(), localCounts.end(), 0));
+
+    if (clusterSize == 1) {
+        gatheredSums = localSums;
+    } else {
+        vector<int> displacements(clusterSize, 0);
+        std::partial_sum(localCounts.begin(), localCounts.end() - 1, displacements.begin() + 1);
+
+        MPI_Datatype type;
+        MPI_Op op;
+        create_scan_blocks_op(type, op);
+
+        MPI_Request requests[2];
+        MPI_Iallreduce(MPI_IN_PLACE, &merged[0], merged.size(), type, op, comm, &requests[0]);
+        MPI_Iallgatherv(localSums.data(), localSums.size(), MPI_DOUBLE, gatheredSums.data(), &localCounts[0],
+                &displacements[0], MPI_DOUBLE, comm, &requests[1]);
+        MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+
+        MPI_Op_free(&op);
+        MPI_Type_free(&type);
+    }
+
+    // Segments of the same rank are gathered in order, and ranks hold ascending indices
+    for (size_t i = 0, gathered = 0; i < segmentCount; i++) {
+        if (owner[i] >= 0) {
+            result.segments[i] = gatheredSums[gathered++];
+        }
+    }
+    for (size_t j = 0; j < mergedSegments.size(); j++) {
+        result.segments[mergedSegments[j]] = fold_scan_blocks(merged[j + 1]);
+    }
+    result.total = fold_scan_blocks(merged[0]);
 
     return result;
 }
 
+template <typename Operator>
+std::unique_ptr<AccumulationRequest> TreeReduction<Operator>::iaccumulate(void) {
+    startPlan();
+
+    // Do the local work and send everything that does not depend on other ranks right away
+    progressPlan(false);
+
+    return std::make_unique<TreeAccumulationRequest<Operator>>(*this);
+}
+
+template <typename Operator>
+double TreeReduction<Operator>::replayPlan(void) {
+    startPlan();
+    progressPlan(true);
+
+    messageBuffer->wait();
+
+    if (finalization == Finalization::BUTTERFLY) {
+        progressButterfly(true);
+    }
+
+    return Operator::result(planResult);
+}
+
+template <typename Operator>
+void TreeReduction<Operator>::startPlan(void) {
+    planSubtree = 0;
+    planSubtreeStarted = false;
+    planResult = value_type {};
+    planRound = 0;
+    planRoundComputed = false;
+    waitingSubtrees.clear();
+
+    messageBuffer->startReduction();
+
+    if (finalization == Finalization::BUTTERFLY) {
+        butterflyDistance = 1;
+
+        // The local inputs of the root are computed by the rank with the first summand
+        if (rootInputOwners[0] == rank) {
+            rootInputs[0] = Operator::leaf(summands[rootSubtree.lastLocalIndex - begin]);
+            for (size_t i = 0; i < rootOperations.size(); i++) {
+                const PlanOperation &op = rootOperations[i];
+                if (op.type == PlanOperation::LOCAL_BLOCK) {
+                    rootInputs[i + 1] = accumulate_block(op.index, op.level);
+                }
+            }
+        }
+    }
+}
+
+template <typename Operator>
+void TreeReduction<Operator>::startSubtree(const uint32_t subtreeIndex) {
+    const PlanSubtree &subtree = plan.subtrees[subtreeIndex];
+
+    if (subtree.flushBefore) {
+        // If we are about to do some considerable amount of work, make sure
+        // the send buffer is empty so noone is waiting for our results
+        messageBuffer->flush();
+    }
+
+    uint64_t blockSummands = 0;
+    for (uint32_t i = subtree.firstOperation; i < subtree.firstOperation + subtree.operationCount; i++) {
+        const PlanOperation &op = plan.operations[i];
+        if (op.type == PlanOperation::LOCAL_BLOCK) {
+            blockSummands += 1UL << op.level;
+        }
+    }
+
+    // Messages that are in flight keep moving while we are busy
+    const bool handOff = progressThread && blockSummands >= (1UL << PROGRESS_BLOCK_LEVEL);
+    if (handOff) {
+        progressThread->handOff();
+    }
+
+    // Local blocks do not depend on other ranks, so compute them before waiting for any message
+    for (uint32_t i = subtree.firstOperation; i < subtree.firstOperation + subtree.operationCount; i++) {
+        const PlanOperation &op = plan.operations[i];
+        if (op.type == PlanOperation::LOCAL_BLOCK) {
+            blockValues[i] = accumulate_block(op.index, op.level);
+        }
+    }
+
+    if (handOff) {
+        progressThread->reclaim();
+    }
+
+    planCursors[subtreeIndex] = SubtreeCursor<value_type> { 0, Operator::leaf(summands[subtree.lastLocalIndex - begin]) };
+}
+
+template <typename Operator>
+bool TreeReduction<Operator>::climbSpine(const uint32_t subtreeIndex, const bool blocking) {
+    const PlanSubtree &subtree = plan.subtrees[subtreeIndex];
+    SubtreeCursor<value_type> &cursor = planCursors[subtreeIndex];
+
+    // Local blocks are left and remote values are right siblings
+    for (; cursor.operation < subtree.operationCount; cursor.operation++) {
+        const uint32_t i = subtree.firstOperation + cursor.operation;
+        const PlanOperation &op = plan.operations[i];
+
+        if (op.type == PlanOperation::LOCAL_BLOCK) {
+            cursor.accumulator = Operator::combine(blockValues[i], cursor.accumulator);
+        } else if (blocking) {
+            cursor.accumulator = Operator::combine(cursor.accumulator, messageBuffer->get(op.rank, op.position));
+        } else {
+            value_type value;
+            if (!messageBuffer->tryGet(op.rank, op.position, value)) {
+                return false;
+            }
+            cursor.accumulator = Operator::combine(cursor.accumulator, value);
+        }
+    }
+
+    if (subtree.targetRank == -1) {
+        planResult = cursor.accumulator;
+    } else if (subtree.targetRank == PlanSubtree::TOP_LEVEL) {
+        for (size_t i = 0; i < rootOperations.size(); i++) {
+            if (rootOperations[i].index == subtree.index) {
+                rootInputs[i + 1] = cursor.accumulator;
+            }
+        }
+    } else {
+        messageBuffer->put(subtree.targetRank, subtree.index, cursor.accumulator);
+    }
+
+    return true;
+}
+
+template <typename Operator>
+bool TreeReduction<Operator>::progressPlan(const bool blocking) {
+    if (neighborhoodBuffer != nullptr) {
+        return progressRounds(blocking);
+    }
+
+    if (scheduling == Scheduling::DATAFLOW) {
+        return progressDataflow(blocking);
+    }
+
+    for (; planSubtree < plan.subtrees.size(); planSubtree++) {
+        if (!planSubtreeStarted) {
+            startSubtree(planSubtree);
+            planSubtreeStarted = true;
+        }
+
+        if (!climbSpine(planSubtree, blocking)) {
+            return false;
+        }
+        planSubtreeStarted = false;
+    }
+    messageBuffer->flush();
+
+    return true;
+}
+
+template <typename Operator>
+bool TreeReduction<Operator>::progressButterfly(const bool blocking) {
+    /* After the exchange with distance d, every rank knows the inputs of the 2d ranks preceding it
+     * (cyclically, including itself). Both sides know who computes which input, so only the values
+     * that the receiver is missing are sent, in the order of the inputs. */
+    for (; butterflyDistance < clusterSize; butterflyDistance *= 2) {
+        const int count = std::min(butterflyDistance, clusterSize - butterflyDistance);
+        const int target = (rank + butterflyDistance) % clusterSize;
+        const int source = (rank - butterflyDistance + clusterSize) % clusterSize;
+
+        if (!butterflyStarted) {
+            int sendCount = 0;
+            for (size_t i = 0; i < rootInputs.size(); i++) {
+                if ((rank - rootInputOwners[i] + clusterSize) % clusterSize < count) {
+                    butterflySendBuffer[sendCount++] = rootInputs[i];
+                }
+            }
+
+            MPI_Irecv(&butterflyReceiveBuffer[0], sizeof(value_type) * butterflyReceiveBuffer.size(), MPI_BYTE,
+                    source, BUTTERFLY_MPI_TAG, comm, &butterflyRequests[0]);
+            MPI_Isend(&butterflySendBuffer[0], sizeof(value_type) * sendCount, MPI_BYTE, target, BUTTERFLY_MPI_TAG,
+                    comm, &butterflyRequests[1]);
+            butterflyStarted = true;
+        }
+
+        if (blocking) {
+            MPI_Waitall(2, butterflyRequests, MPI_STATUSES_IGNORE);
+        } else {
+            int completed;
+            MPI_Testall(2, butterflyRequests, &completed, MPI_STATUSES_IGNORE);
+            if (!completed) return false;
+        }
+        butterflyStarted = false;
+
+        int received = 0;
+        for (size_t i = 0; i < rootInputs.size(); i++) {
+            if ((source - rootInputOwners[i] + clusterSize) % clusterSize < count) {
+                rootInputs[i] = butterflyReceiveBuffer[received++];
+            }
+        }
+    }
+
+    planResult = evaluateRootInputs();
+
+    return true;
+}
+
+template <typename Operator>
+void TreeReduction<Operator>::gatherRootInputs(const int root) {
+    /* Every owner sends its inputs in one message, in the order of the inputs, so the receiver can
+     * place them without transmitting indices */
+    if (rank != root) {
+        int sendCount = 0;
+        for (size_t i = 0; i < rootInputs.size(); i++) {
+            if (rootInputOwners[i] == rank) {
+                butterflySendBuffer[sendCount++] = rootInputs[i];
+            }
+        }
+
+        if (sendCount > 0) {
+            MPI_Send(&butterflySendBuffer[0], sizeof(value_type) * sendCount, MPI_BYTE, root, BUTTERFLY_MPI_TAG,
+                    comm);
+        }
+        return;
+    }
+
+    vector<int> owners;
+    for (const int owner : rootInputOwners) {
+        if (owner != rank && std::find(owners.begin(), owners.end(), owner) == owners.end()) {
+            owners.push_back(owner);
+        }
+    }
+
+    for (const int owner : owners) {
+        MPI_Recv(&butterflyReceiveBuffer[0], sizeof(value_type) * butterflyReceiveBuffer.size(), MPI_BYTE, owner,
+                BUTTERFLY_MPI_TAG, comm, MPI_STATUS_IGNORE);
+
+        int received = 0;
+        for (size_t i = 0; i < rootInputs.size(); i++) {
+            if (rootInputOwners[i] == owner) {
+                rootInputs[i] = butterflyReceiveBuffer[received++];
+            }
+        }
+    }
+
+    planResult = evaluateRootInputs();
+}
+
+template <typename Operator>
+const typename TreeReduction<Operator>::value_type TreeReduction<Operator>::evaluateRootInputs(void) const {
+    // Same operations as climbSpine on the rank with the first summand
+    value_type accumulator = rootInputs[0];
+    for (size_t i = 0; i < rootOperations.size(); i++) {
+        if (rootOperations[i].type == PlanOperation::LOCAL_BLOCK) {
+            accumulator = Operator::combine(rootInputs[i + 1], accumulator);
+        } else {
+            accumulator = Operator::combine(accumulator, rootInputs[i + 1]);
+        }
+    }
+
+    return accumulator;
+}
+
+template <typename Operator>
+bool TreeReduction<Operator>::progressRounds(const bool blocking) {
+    // The transport is only used together with this execution order
+    NeighborhoodMessageBuffer<value_type> &buffer = *neighborhoodBuffer;
+
+    for (; planRound < buffer.rounds(); planRound++) {
+        if (!planRoundComputed) {
+            // All remote values of this round have been received in earlier exchanges
+            for (uint32_t i = 0; i < plan.subtrees.size(); i++) {
+                if (plan.subtrees[i].round == planRound) {
+                    startSubtree(i);
+                    climbSpine(i, true);
+                }
+            }
+            planRoundComputed = true;
+        }
+
+        if (!buffer.exchange(planRound, blocking)) {
+            return false;
+        }
+        planRoundComputed = false;
+    }
+
+    return true;
+}
+
+template <typename Operator>
+bool TreeReduction<Operator>::progressDataflow(const bool blocking) {
+    // Do all the local work first, everything that does not depend on other ranks is sent right away
+    for (; planSubtree < plan.subtrees.size(); planSubtree++) {
+        startSubtree(planSubtree);
+
+        if (!climbSpine(planSubtree, false)) {
+            waitingSubtrees.push_back(planSubtree);
+        }
+    }
+    messageBuffer->flush();
+
+    while (!waitingSubtrees.empty()) {
+        // Resume every subtree whose next remote value is available
+        std::erase_if(waitingSubtrees, [this] (const uint32_t subtreeIndex) {
+            return climbSpine(subtreeIndex, false);
+        });
+        messageBuffer->flush();
+
+        if (!waitingSubtrees.empty() && !messageBuffer->receiveAny(blocking) && !blocking) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename Operator>
+const ReductionPlan& TreeReduction<Operator>::getPlan(void) const {
+    return plan;
+}
+
+template <typename Operator>
+void TreeReduction<Operator>::setScheduling(const Scheduling scheduling) {
+    if (scheduling != Scheduling::IN_ORDER && transportMode == TransportMode::NEIGHBORHOOD) {
+        throw logic_error("The neighborhood transport computes the subtrees round by round");
+    }
+
+    this->scheduling = scheduling;
+}
+
+void BinaryTreeSummation::setKernel(const KernelVariant variant) {
+    kernel = &TreeKernels::get(variant);
+}
+
+const AccumulationKernel& BinaryTreeSummation::getKernel(void) const {
+    return *kernel;
+}
+
+template <typename Operator>
+void TreeReduction<Operator>::setThreads(const int threads) {
+    assert(threads >= 1);
+    this->threads = threads;
+}
+
+template <typename Operator>
+void TreeReduction<Operator>::setProgressThread(const bool enabled) {
+    if (!enabled || transportMode == TransportMode::NEIGHBORHOOD) {
+        progressThread.reset();
+        return;
+    }
+
+    int provided;
+    MPI_Query_thread(&provided);
+    if (provided < MPI_THREAD_SERIALIZED) {
+        throw runtime_error("The progress thread requires MPI_THREAD_SERIALIZED");
+    }
+
+    /* Make sure our sends are completed and unpack whatever has arrived. Outgoing messages are not
+     * flushed here, they are only sent once full or when the rank itself flushes them */
+    progressThread = std::make_unique<ProgressThread>([this] () {
+        messageBuffer->receiveAvailable();
+        messageBuffer->test();
+    });
+}
+
 
 double BinaryTreeSummation::recursiveAccumulate(uint64_t index) {
 #ifdef ENABLE_INSTRUMENTATION
@@ -370,25 +1947,12 @@ double BinaryTreeSummation::accumulate(const uint64_t index) {
     uint64_t elementsInBuffer = n_local_elements;
 
     double *sourceBuffer = static_cast<double *>(&summands[index - begin]);
-    double *destinationBuffer = static_cast<double *>(&accumulationBuffer[0]);
+    double *destinationBuffer = reserveAccumulationBuffer(n_local_elements);
 
 
     for (int y = 1; y <= maxY; y += 3) {
-        uint64_t elementsWritten = 0;
-
-        for (uint64_t i = 0; i + 8 <= elementsInBuffer; i += 8) {
-            __m256d a = _mm256_loadu_pd(static_cast<double *>(&sourceBuffer[i]));
-            __m256d b = _mm256_loadu_pd(static_cast<double *>(&sourceBuffer[i+4]));
-            __m256d level1Sum = _mm256_hadd_pd(a, b);
-
-            __m128d c = _mm256_extractf128_pd(level1Sum, 1); // Fetch upper 128bit
-            __m128d d = _mm256_castpd256_pd128(level1Sum); // Fetch lower 128bit
-            __m128d level2Sum = _mm_add_pd(c, d);
-
-            __m128d level3Sum = _mm_hadd_pd(level2Sum, level2Sum);
-
-            destinationBuffer[elementsWritten++] = _mm_cvtsd_f64(level3Sum);
-        }
+        uint64_t elementsWritten = elementsInBuffer / 8;
+        TreeKernels::accumulate_8subtrees(sourceBuffer, destinationBuffer, elementsWritten);
 
         // number of remaining elements
         const uint64_t remainder = elementsInBuffer - 8 * elementsWritten;
@@ -426,6 +1990,7 @@ double BinaryTreeSummation::nocheckAccumulate(void) {
     uint64_t largest_local_index = min(maxX, end - 1);
     uint64_t n_local_elements = largest_local_index + 1;
 
+    reserveAccumulationBuffer(n_local_elements);
     for (size_t i = 0; i < n_local_elements; i++) {
         accumulationBuffer[i] = summands[i];
     }
@@ -453,6 +2018,14 @@ double BinaryTreeSummation::nocheckAccumulate(void) {
 
 }
 
+double *BinaryTreeSummation::reserveAccumulationBuffer(const uint64_t elements) {
+    if (accumulationBuffer.size() < elements) {
+        accumulationBuffer.resize(elements);
+    }
+
+    return accumulationBuffer.data();
+}
+
 const double BinaryTreeSummation::acquisitionTime(void) const {
     return std::chrono::duration_cast<std::chrono::nanoseconds> (acquisitionDuration).count();
 }
@@ -485,8 +2058,139 @@ const double BinaryTreeSummation::accumulate_local_8subtree(const uint64_t start
     return level2a + level2b;
 }
 
-const void BinaryTreeSummation::printStats() const {
-    messageBuffer.printStats();
+template <typename Operator>
+const typename TreeReduction<Operator>::value_type TreeReduction<Operator>::accumulate_block(
+        const uint64_t startIndex, const int level) {
+    if (threads == 1 || level < PARALLEL_BLOCK_LEVEL) {
+        return stream_block(startIndex, level);
+    }
+
+    /* Split the block into complete subtrees, a few per thread to balance the load. Combining their
+     * values pairwise afterwards performs the same operations as the single-threaded computation. */
+    int splitLevels = 0;
+    while ((1 << splitLevels) < 4 * threads && level - splitLevels > PARALLEL_BLOCK_LEVEL - 3) {
+        splitLevels++;
+    }
+    const int chunkLevel = level - splitLevels;
+    const int chunks = 1 << splitLevels;
+
+    vector<value_type> chunkValues(chunks);
+
+    #pragma omp parallel for num_threads(threads) schedule(dynamic)
+    for (int c = 0; c < chunks; c++) {
+        const uint64_t offset = static_cast<uint64_t>(c) << chunkLevel;
+        chunkValues[c] = stream_block(startIndex + offset, chunkLevel);
+    }
+
+    for (int n = chunks / 2; n >= 1; n /= 2) {
+        for (int i = 0; i < n; i++) {
+            chunkValues[i] = Operator::combine(chunkValues[2 * i], chunkValues[2 * i + 1]);
+        }
+    }
+
+    return chunkValues[0];
+}
+
+template <typename Operator>
+const typename TreeReduction<Operator>::value_type TreeReduction<Operator>::stream_block(
+        const uint64_t startIndex, const int level) const {
+    const double *source = &summands[startIndex - begin];
+
+    if (level <= STREAM_CHUNK_LEVEL) {
+        return accumulate_chunk(source, level);
+    }
+
+    /* Read the block once, one chunk at a time. Chunk values are folded like a binary counter: after
+     * chunk c, one value is pending for every bit set in c + 1, and the trailing ones of c tell how many
+     * pending values form a complete subtree together with the current chunk. */
+    array<value_type, 64> pending;
+    int pendingCount = 0;
+
+    const uint64_t chunks = 1UL << (level - STREAM_CHUNK_LEVEL);
+    for (uint64_t c = 0; c < chunks; c++) {
+        value_type value = accumulate_chunk(source + (c << STREAM_CHUNK_LEVEL), STREAM_CHUNK_LEVEL);
+
+        for (uint64_t carry = c; carry & 1; carry >>= 1) {
+            value = Operator::combine(pending[--pendingCount], value);
+        }
+
+        pending[pendingCount++] = value;
+    }
+
+    assert(pendingCount == 1);
+    return pending[0];
+}
+
+template <typename Operator>
+const typename TreeReduction<Operator>::value_type TreeReduction<Operator>::accumulate_chunk(
+        const double *source, const int level) const {
+    assert(level <= STREAM_CHUNK_LEVEL);
+
+    if constexpr (std::is_same_v<Operator, SumOperator>) {
+        switch (level) {
+            case 0:
+                return source[0];
+            case 1:
+                return source[0] + source[1];
+            case 2:
+                return (source[0] + source[1]) + (source[2] + source[3]);
+        }
+
+        // Partial sums stay in L1 cache, only the first pass reads from the summands
+        alignas(64) array<double, (1UL << STREAM_CHUNK_LEVEL) / 8> buffer;
+        double *destination = buffer.data();
+        uint64_t elements = 1UL << level;
+        int remainingLevels = level;
+
+        // Reduce as many levels at once as the kernel supports ...
+        for (; remainingLevels >= kernel->levels; remainingLevels -= kernel->levels) {
+            elements >>= kernel->levels;
+            kernel->reduce(source, destination, elements);
+            source = destination;
+        }
+
+        // ... and the remaining levels pairwise
+        for (; remainingLevels > 0; remainingLevels--) {
+            elements /= 2;
+            for (uint64_t i = 0; i < elements; i++) {
+                destination[i] = source[2 * i] + source[2 * i + 1];
+            }
+            source = destination;
+        }
+
+        return source[0];
+    } else {
+        if (level == 0) {
+            return Operator::leaf(source[0]);
+        }
+
+        // Values stay in L1 cache, only the first level reads from the summands
+        array<value_type, (1UL << STREAM_CHUNK_LEVEL) / 2> buffer;
+        uint64_t pairs = 1UL << (level - 1);
+        Operator::reduce_leaves(source, buffer.data(), pairs);
+
+        while (pairs > 1) {
+            pairs /= 2;
+            Operator::reduce_pairs(buffer.data(), buffer.data(), pairs);
+        }
+
+        return buffer[0];
+    }
+}
+
+template <typename Operator>
+const void TreeReduction<Operator>::printStats() const {
+    messageBuffer->printStats();
+
+    if (progressThread) {
+        unsigned long localSteps = progressThread->steps();
+        unsigned long globalSteps = 0;
+        MPI_Reduce(&localSteps, &globalSteps, 1, MPI_UNSIGNED_LONG, MPI_SUM, ROOT_RANK, comm);
+
+        if (rank == ROOT_RANK) {
+            printf("progressSteps=%lu\n", globalSteps);
+        }
+    }
 }
 
 const int BinaryTreeSummation::rankFromIndexClosedForm(const uint64_t index) const {
@@ -520,3 +2224,28 @@ double BinaryTreeSummation::global_sum(const double *data, const size_t dataLeng
 
     return strategy.accumulate();
 }
+
+/* The operators of tree_operators.hpp, another operator needs its own instantiations here */
+template class MessageBuffer<double>;
+template class PersistentMessageBuffer<double>;
+template class SharedMemoryMessageBuffer<double>;
+template class OneSidedMessageBuffer<double>;
+template class NeighborhoodMessageBuffer<double>;
+
+template class MessageBuffer<LogSumExpValue>;
+template class PersistentMessageBuffer<LogSumExpValue>;
+template class SharedMemoryMessageBuffer<LogSumExpValue>;
+template class OneSidedMessageBuffer<LogSumExpValue>;
+template class NeighborhoodMessageBuffer<LogSumExpValue>;
+
+template class TreeAccumulationRequest<SumOperator>;
+template class TreeAccumulationRequest<ProductOperator>;
+template class TreeAccumulationRequest<MinOperator>;
+template class TreeAccumulationRequest<MaxOperator>;
+template class TreeAccumulationRequest<LogSumExpOperator>;
+
+template class TreeReduction<SumOperator>;
+template class TreeReduction<ProductOperator>;
+template class TreeReduction<MinOperator>;
+template class TreeReduction<MaxOperator>;
+template class TreeReduction<LogSumExpOperator>;
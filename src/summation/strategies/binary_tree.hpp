@@ -1,4 +1,8 @@
 #include "summation_strategy.hpp"
+#include "reduction_plan.hpp"
+#include "tree_kernels.hpp"
+#include "tree_operators.hpp"
+#include "progress_thread.hpp"
 #include "util.hpp"
 #include <cassert>
 #include <cstdint>
@@ -6,6 +10,7 @@
 #include <chrono>
 #include <array>
 #include <map>
+#include <memory>
 #include <utility>
 #include <mpi.h>
 #include <util.hpp>
@@ -14,43 +19,516 @@ using std::vector;
 using std::array;
 using std::map;
 
-const uint8_t MAX_MESSAGE_LENGTH = 4;
-
+/* Message buffers carry the values of the reduction operator, see TreeReduction. Values are sent as
+ * raw bytes, so they must be trivially copyable. */
+template <typename Value>
 struct MessageBufferEntry {
     uint64_t index;
-    double value;
+    Value value;
+};
+
+/* The persistent transport knows the layout of every message from the plan, so only the values are
+ * sent. Defining CHECK_MESSAGE_INDICES sends the indices along and checks them on arrival. */
+#ifdef CHECK_MESSAGE_INDICES
+template <typename Value>
+using PlanMessageEntry = MessageBufferEntry<Value>;
+#else
+template <typename Value>
+using PlanMessageEntry = Value;
+#endif
+
+/* How rank-intersecting summands are exchanged between ranks. ISEND is the default: SHARED takes a
+ * quarter less per round trip in mpi_send_bench, but RADTree runs on one node gained only on some
+ * inputs, and RMA took two to four times as long as ISEND */
+enum class TransportMode {
+    ISEND,          // A fresh MPI_Isend/MPI_Recv for every message
+    PERSISTENT,     // Persistent requests that are set up once and restarted for every reduction
+    SHARED,         // Shared memory between ranks on the same node, MPI_Isend only across nodes
+    RMA,            // MPI_Put into a window of the receiver, no matching receives needed
+    NEIGHBORHOOD    // One neighborhood collective per round, the subtrees are computed round by round
+};
+
+/* Order in which the subtrees of the reduction plan are computed */
+enum class Scheduling {
+    IN_ORDER,       // One subtree after another, waiting for remote values as soon as they are needed
+    DATAFLOW        // All local work first, then whichever subtree's remote value arrives next
+};
+
+/* How the result reaches all ranks */
+enum class Finalization {
+    BROADCAST,      // The rank with the first summand computes the root and broadcasts it
+    BUTTERFLY       // All ranks exchange the inputs of the root by recursive doubling and compute it
+};
+
+/* Decomposition of a range of indices into the largest complete, aligned subtrees, in index order.
+ * Used by BinaryTreeSummation::scan, it is sent as raw bytes */
+struct ScanBlocks {
+    struct Block {
+        uint64_t index;     // first leaf of the subtree
+        int level;          // log2 of the number of leaves
+        double value;
+    };
+
+    uint32_t count;
+    Block blocks[2 * 64];
+};
+
+/* Result of BinaryTreeSummation::accumulate_segments */
+struct SegmentSums {
+    vector<double> segments;
+    double total;
+};
+
+/* Position of a subtree's computation along its spine */
+template <typename Value>
+struct SubtreeCursor {
+    uint32_t operation;
+    Value accumulator;
 };
 
+template <typename Value>
 class MessageBuffer {
 
 public:
-    MessageBuffer(MPI_Comm comm);
+    /* Messages are sized after the plan, a message never holds more entries than the largest one
+     * the plan sends to that target */
+    MessageBuffer(MPI_Comm comm, const ReductionPlan &plan);
+    virtual ~MessageBuffer();
+
     const void receive(const int sourceRank);
-    void flush(void);
-    void wait(void);
+    virtual void flush(void);
+    virtual void wait(void);
+
+    /* Called once at the beginning of every reduction */
+    virtual void startReduction(void);
+
+    virtual void put(const int targetRank, const uint64_t index, const Value value);
 
-    void put(const int targetRank, const uint64_t index, const double value);
-    const double get(const int sourceRank, const uint64_t index);
+    /* Remote values are addressed by their position in the plan, see PlanOperation::position */
+    virtual const Value get(const int sourceRank, const uint32_t position);
+
+    /* Nonblocking variant of get, returns false if the number has not arrived yet */
+    virtual bool tryGet(const int sourceRank, const uint32_t position, Value &value);
+
+    /* Unpack messages from any source into the inbox. If blocking, wait for at least one message.
+     * Returns false if nothing has been received */
+    virtual bool receiveAny(const bool blocking);
+
+    /* Unpack what has already arrived without waiting. Unlike receiveAny, partially filled outgoing
+     * messages are left alone, so this is safe to call while the owner keeps adding values */
+    virtual bool receiveAvailable(void);
+
+    /* Check without blocking whether all messages that have been sent are completed */
+    virtual bool test(void);
 
     const void printStats(void) const;
 
 protected:
-    array<MessageBufferEntry, MAX_MESSAGE_LENGTH> entries;
-    map<uint64_t, double> inbox;
+    /* Take a buffer from the pool to write the next outgoing message into. Only blocks if all
+     * buffers are in flight */
+    int acquireSendBuffer(void);
+
+    /* Return the buffers of completed sends to the pool, if blocking wait for at least one */
+    void reclaimSendBuffers(const bool blocking);
+
+    int sendsInFlight(void) const;
+
+    /* Place a received value into its slot of the inbox */
+    void deliver(const uint32_t position, const Value value);
+
+    /* Take a value out of the inbox, returns false if it has not arrived yet */
+    bool take(const uint32_t position, Value &value);
+
+    /* Position in the plan of the target rank for every subtree that is sent, in the order of the
+     * subtrees. Collective, since every rank tells its sources where their values start */
+    vector<uint32_t> targetPositions(void) const;
+
+    /* Outgoing messages are written into a pool of buffers, so a message can be started while
+     * earlier ones are still in flight */
+    static const int SEND_POOL_SIZE = 16;
+
+    const ReductionPlan &plan;
+
+    /* Every remote value of the plan has a slot, addressed by its position */
+    vector<Value> inbox;
+    vector<bool> arrived;
+
+    /* Number of remote values that every source sends as messages per reduction, and how many of
+     * them have not been received yet in the current one */
+    map<int, uint32_t> expectedValues;
+    map<int, uint32_t> outstandingValues;
+
     int targetRank;
-    vector<MessageBufferEntry> outbox;
-    vector<MessageBufferEntry> buffer;
-    vector<MPI_Request> reqs;
+    map<int, uint32_t> messageCapacity;
+    uint32_t sendBufferSize;
+    vector<MessageBufferEntry<Value>> sendPool;
+    vector<MPI_Request> sendPoolRequests;
+    vector<int> freeSendBuffers;
+    vector<int> completedSends;
+    int currentSendBuffer;      // buffer of the message that is being written, -1 if none
+    size_t outboxSize;
+    vector<MessageBufferEntry<Value>> buffer;
     size_t awaitedNumbers;
     size_t sentMessages;
     size_t sentSummands;
-    bool sendBufferClear;
+    size_t sentBytes;
+    size_t sendPoolExhausted;   // number of times put had to wait for a send to complete
     MPI_Comm comm;
 };
 
-class BinaryTreeSummation : public SummationStrategy {
+/* Since the communication pattern never changes between reductions, all messages described by the
+ * reduction plan get their own persistent request. Receives are started all at once at the beginning
+ * of a reduction, sends as soon as the last entry of a message has been put. Messages between two
+ * ranks are told apart by their tag, so they may be started in any order. */
+template <typename Value>
+class PersistentMessageBuffer : public MessageBuffer<Value> {
+
+public:
+    PersistentMessageBuffer(MPI_Comm comm, const ReductionPlan &plan);
+    virtual ~PersistentMessageBuffer();
+
+    virtual void flush(void);
+    virtual void wait(void);
+    virtual void startReduction(void);
+
+    virtual void put(const int targetRank, const uint64_t index, const Value value);
+    virtual const Value get(const int sourceRank, const uint32_t position);
+    virtual bool tryGet(const int sourceRank, const uint32_t position, Value &value);
+    virtual bool receiveAny(const bool blocking);
+    virtual bool receiveAvailable(void);
+    virtual bool test(void);
+
+protected:
+    /* Unpack the next message of a source, optionally without waiting for it */
+    bool unpackNextMessage(const int sourceRank, const bool blocking);
+    void unpackMessage(const uint32_t messageIndex);
+
+    vector<PlanMessageEntry<Value>> sendBuffer;
+    vector<PlanMessageEntry<Value>> receiveBuffer;
+    vector<MPI_Request> sendRequests;
+    vector<MPI_Request> receiveRequests;
+
+    /* Subtrees may be completed out of order, so each message is started once all of its entries
+     * have been put */
+    vector<uint64_t> outgoingIndices;
+    vector<uint32_t> entryMessage;
+    vector<uint32_t> filledEntries;
+    uint32_t startedMessages;
+
+    vector<MPI_Status> receiveStatuses;
+    vector<int> completedReceives;
+    vector<bool> unpacked;
+
+    /* Incoming messages that have not been unpacked yet, per source rank */
+    map<int, vector<uint32_t>> pendingMessages;
+    map<int, size_t> nextPendingMessage;
+};
+
+/* Slot of a window that receives remote values, the value is valid once the generation matches the
+ * current reduction. Reductions are not necessarily separated by a collective, see
+ * TreeReduction::accumulate_to, so the sender only writes the next value once the receiver has
+ * consumed the previous one. */
+template <typename Value>
+struct WindowSlot {
+    Value value;
+    uint64_t generation;
+    uint64_t consumed;      // generation of the last value the receiver has taken out of the slot
+};
+
+/* Ranks on the same node hand their values over through a window allocated with
+ * MPI_Win_allocate_shared, in which every rank exposes one slot per remote value of its plan. The
+ * sender writes the value and then publishes it by setting the generation of the slot, the receiver
+ * polls the generation. Values from ranks on other nodes are sent as messages. */
+template <typename Value>
+class SharedMemoryMessageBuffer : public MessageBuffer<Value> {
+
+public:
+    SharedMemoryMessageBuffer(MPI_Comm comm, const ReductionPlan &plan);
+    virtual ~SharedMemoryMessageBuffer();
+
+    virtual void startReduction(void);
+
+    virtual void put(const int targetRank, const uint64_t index, const Value value);
+    virtual const Value get(const int sourceRank, const uint32_t position);
+    virtual bool tryGet(const int sourceRank, const uint32_t position, Value &value);
+    virtual bool receiveAny(const bool blocking);
+    virtual bool receiveAvailable(void);
+
+protected:
+    bool isNodeLocal(const int rank) const;
+
+    /* Copy a value from the window into the inbox if it has been published in this reduction */
+    bool poll(const uint32_t position);
+
+    MPI_Comm nodeComm;
+    MPI_Win window;
+    WindowSlot<Value> *slots;
+    uint64_t generation;
+
+    vector<int> nodeRanks;              // rank within the node, MPI_UNDEFINED for other nodes
+    vector<uint64_t> outgoingIndices;
+    vector<WindowSlot<Value> *> outgoingSlots; // slot in the window of the target, nullptr for other nodes
+    vector<uint32_t> sharedPositions;   // remote values that arrive through the window
+    vector<bool> polled;
+};
+
+/* Every rank exposes a window with one slot per remote value of its plan, into which the senders
+ * write with MPI_Put as soon as a value is computed. The value is flushed to the target before its
+ * generation is written, so the receiver only has to poll the generations of its own window. */
+template <typename Value>
+class OneSidedMessageBuffer : public MessageBuffer<Value> {
+
+public:
+    OneSidedMessageBuffer(MPI_Comm comm, const ReductionPlan &plan);
+    virtual ~OneSidedMessageBuffer();
+
+    virtual void startReduction(void);
+
+    virtual void put(const int targetRank, const uint64_t index, const Value value);
+    virtual const Value get(const int sourceRank, const uint32_t position);
+    virtual bool tryGet(const int sourceRank, const uint32_t position, Value &value);
+    virtual bool receiveAny(const bool blocking);
+    virtual bool receiveAvailable(void);
+
+protected:
+    /* Copy a value from the window into the inbox if it has been published in this reduction */
+    bool poll(const uint32_t position);
+
+    int rank;
+    MPI_Win window;
+    WindowSlot<Value> *slots;
+    uint64_t generation;
+
+    vector<uint64_t> outgoingIndices;
+    vector<uint32_t> outgoingPositions;
+    vector<bool> polled;
+};
+
+/* All values that are computed in the same round are exchanged by a single neighborhood collective,
+ * on a graph topology that connects every rank with the ranks it sends to and receives from. Since
+ * every rank takes part in every exchange, the subtrees have to be computed round by round, see
+ * ReductionPlan::roundCount. */
+template <typename Value>
+class NeighborhoodMessageBuffer : public MessageBuffer<Value> {
+
+public:
+    NeighborhoodMessageBuffer(MPI_Comm comm, const ReductionPlan &plan);
+    virtual ~NeighborhoodMessageBuffer();
+
+    virtual void startReduction(void);
+
+    virtual void put(const int targetRank, const uint64_t index, const Value value);
+    virtual const Value get(const int sourceRank, const uint32_t position);
+    virtual bool tryGet(const int sourceRank, const uint32_t position, Value &value);
+
+    /* Exchange the values of a round with all neighbors. Returns false if not blocking and the
+     * exchange has not completed yet, in which case it must be called again */
+    bool exchange(const uint32_t round, const bool blocking);
+
+    /* Largest number of rounds of any rank */
+    uint32_t rounds(void) const;
+
+protected:
+    MPI_Comm graphComm;
+    MPI_Datatype valueType;                 // a value as contiguous bytes
+    uint32_t roundCount;
+    vector<int> sources;
+    vector<int> destinations;
+
+    vector<uint64_t> outgoingIndices;
+    vector<uint32_t> sendSlots;             // slot of every outgoing entry in the send buffer
+    vector<uint32_t> receivedPositions;     // position of the value in every slot of the receive buffer
+    vector<Value> sendBuffer;
+    vector<Value> receiveBuffer;
+
+    /* Arguments of the collective, for every round and neighbor */
+    vector<int> sendCounts;
+    vector<int> sendDisplacements;
+    vector<int> receiveCounts;
+    vector<int> receiveDisplacements;
+
+    bool exchangeStarted;
+    MPI_Request exchangeRequest;
+};
+
+template <typename Operator>
+class TreeReduction;
+
+/* Nonblocking reduction, see TreeReduction::iaccumulate */
+template <typename Operator>
+class TreeAccumulationRequest : public AccumulationRequest {
+public:
+    TreeAccumulationRequest(TreeReduction<Operator> &tree);
+    virtual bool test();
+    virtual double wait();
+
+protected:
+    TreeReduction<Operator> &tree;
+    bool reduced;
+    bool broadcastStarted;
+    bool completed;
+    MPI_Request broadcastRequest;
+    double result;
+};
+
+/* Reduces the summands with an operator from tree_operators.hpp along the reduction plan, for
+ * example the maximum or the log-sum-exp of log-likelihoods. The values of the operator take the
+ * place of the partial sums, in the messages of every transport as well as in the finalization, so
+ * all options of the sum are available and the result does not depend on the number of ranks.
+ * BinaryTreeSummation is the reduction with SumOperator. The template is instantiated for the
+ * operators of tree_operators.hpp in binary_tree.cpp. */
+template <typename Operator>
+class TreeReduction : public SummationStrategy {
+    friend class TreeAccumulationRequest<Operator>;
+
 public:
-    BinaryTreeSummation(uint64_t rank, vector<int> &n_summands, MPI_Comm comm = MPI_COMM_WORLD);
+    using value_type = typename Operator::value_type;
+
+    /* Messages are exchanged on a duplicate of comm, so other reductions on the same ranks may run
+     * at the same time */
+    TreeReduction(uint64_t rank, vector<int> &n_summands, MPI_Comm comm = MPI_COMM_WORLD,
+            TransportMode transportMode = TransportMode::ISEND,
+            Finalization finalization = Finalization::BROADCAST,
+            SendSchedule sendSchedule = SendSchedule::LOCAL_WORK);
+
+    virtual ~TreeReduction();
+
+    /* Reduce all numbers. Will return the result on all ranks
+     */
+    double accumulate(void);
+
+    /* Reduce all numbers and deliver the result to root only, without a broadcast. With
+     * Finalization::BUTTERFLY the inputs of the root are sent to root directly. Otherwise the plan
+     * ends on the rank with the first summand, which forwards the result in one more message when
+     * root is a different rank */
+    double accumulate_to(const int root);
+
+    /* Start the reduction and return immediately. The plan is executed whenever the returned request
+     * is tested, values that have not arrived yet are skipped until the next test */
+    std::unique_ptr<AccumulationRequest> iaccumulate(void);
+
+    /* Replay the reduction plan that has been computed in the constructor. Will return the
+     * result on rank 0, or on all ranks with Finalization::BUTTERFLY */
+    double replayPlan(void);
+
+    const ReductionPlan& getPlan(void) const;
+
+    /* Select the order in which the subtrees are computed. Does not affect the result.
+     * TransportMode::NEIGHBORHOOD always computes the subtrees round by round and only allows
+     * Scheduling::IN_ORDER */
+    void setScheduling(const Scheduling scheduling);
+
+    /* Compute large local blocks with that many threads. The result does not depend on the number
+     * of threads */
+    void setThreads(const int threads);
+
+    /* Hand the communication over to a dedicated thread while large local blocks are computed,
+     * instead of only flushing before them. Requires MPI_THREAD_SERIALIZED and has no effect with
+     * TransportMode::NEIGHBORHOOD, where nothing is in flight while a round is computed */
+    void setProgressThread(const bool enabled);
+
+    const void printStats(void) const;
+
+protected:
+    /** Reduce a complete block of 2^level local summands in tree order, large blocks are split among
+     * all threads */
+    const value_type accumulate_block(const uint64_t startIndex, const int level);
+
+    /** Reduce a complete block on the calling thread in a single pass over the summands */
+    const value_type stream_block(const uint64_t startIndex, const int level) const;
+
+    /** Reduce a complete subtree of at most 2^STREAM_CHUNK_LEVEL values. Sums use the kernel, the
+     * other operators their own reduce_leaves and reduce_pairs */
+    const value_type accumulate_chunk(const double *source, const int level) const;
+
+    /** Blocks are streamed in chunks of 2^STREAM_CHUNK_LEVEL summands whose partial sums fit into L1 */
+    static const int STREAM_CHUNK_LEVEL = 10;
+
+    /** Subtrees whose local blocks contain at least 2^PROGRESS_BLOCK_LEVEL summands are computed
+     * while the progress thread communicates. A handOff and reclaim (BM_progressHandoff, 4.2us) takes
+     * longer than a block of 2^14 summands (BM_blockReplay, 2.6us), but only 5% of one with 2^18 */
+    static const int PROGRESS_BLOCK_LEVEL = 18;
+
+    /** Blocks with at least 2^PARALLEL_BLOCK_LEVEL summands are computed by multiple threads. Even
+     * a parallel loop that wakes no other thread (BM_parallelRegion/1, 0.6us) costs a fifth of a
+     * block of 2^14 summands, but only 5% of one with 2^16 (BM_blockReplay, 10-14us) */
+    static const int PARALLEL_BLOCK_LEVEL = 16;
+
+    /** Reset the execution state before replaying the plan */
+    void startPlan(void);
+
+    /** Execute the plan until it is complete or, if not blocking, until a remote value is missing.
+     * Returns true once all subtrees have been computed */
+    bool progressPlan(const bool blocking);
+
+    /** Exchange the inputs of the root with the other ranks and compute it, once the plan has been
+     * executed. Returns false if not blocking and an exchange has not completed yet */
+    bool progressButterfly(const bool blocking);
+
+    /** Send the inputs of the root to a single rank, which evaluates the spine of the root */
+    void gatherRootInputs(const int root);
+
+    /** Same operations as climbSpine on the rank with the first summand, once all inputs are known */
+    const value_type evaluateRootInputs(void) const;
+
+    /** Execute the plan round by round, exchanging the values of every round with a neighborhood
+     * collective */
+    bool progressRounds(const bool blocking);
+
+    /** Execute the plan as a dependency graph. Every subtree is started right away and resumed as soon
+     * as the next remote value on its spine has been received */
+    bool progressDataflow(const bool blocking);
+
+    /** Flush if necessary and compute the local blocks of a subtree */
+    void startSubtree(const uint32_t subtreeIndex);
+
+    /** Climb up the spine of a subtree and pass its value on once the root is reached. If not blocking,
+     * stop at the first remote value that has not arrived. Returns true if the subtree is complete */
+    bool climbSpine(const uint32_t subtreeIndex, const bool blocking);
+
+    const uint64_t size,  begin, end;
+    const Finalization finalization;
+    const ReductionPlan plan;
+
+    /* With Finalization::BUTTERFLY every rank evaluates the spine of the root. Its inputs are the first
+     * leaf and the sibling of every operation, each of which is computed by one rank */
+    PlanSubtree rootSubtree;
+    vector<PlanOperation> rootOperations;
+    vector<value_type> rootInputs;
+    vector<int> rootInputOwners;
+    vector<value_type> butterflySendBuffer;
+    vector<value_type> butterflyReceiveBuffer;
+    int butterflyDistance;
+    bool butterflyStarted;
+    MPI_Request butterflyRequests[2];
+
+    /* Execution state of the plan, so a nonblocking reduction can be resumed */
+    size_t planSubtree;
+    bool planSubtreeStarted;
+    value_type planResult;
+    vector<SubtreeCursor<value_type>> planCursors;
+    vector<uint32_t> waitingSubtrees;
+    vector<value_type> blockValues;
+    uint32_t planRound;
+    bool planRoundComputed;
+    Scheduling scheduling;
+    TransportMode transportMode;
+    int threads;
+    const AccumulationKernel *kernel;   // only used by SumOperator
+
+    std::unique_ptr<MessageBuffer<value_type>> messageBuffer;
+    NeighborhoodMessageBuffer<value_type> *neighborhoodBuffer;  // the message buffer with TransportMode::NEIGHBORHOOD
+
+    /* Declared after the message buffer, so it is stopped before the buffer is destroyed */
+    std::unique_ptr<ProgressThread> progressThread;
+};
+
+class BinaryTreeSummation : public TreeReduction<SumOperator> {
+public:
+    BinaryTreeSummation(uint64_t rank, vector<int> &n_summands, MPI_Comm comm = MPI_COMM_WORLD,
+            TransportMode transportMode = TransportMode::ISEND,
+            Finalization finalization = Finalization::BROADCAST,
+            SendSchedule sendSchedule = SendSchedule::LOCAL_WORK);
 
     virtual ~BinaryTreeSummation();
 
@@ -67,10 +545,29 @@ public:
 
     const double acquireNumber(const uint64_t index);
 
+    using TreeReduction<SumOperator>::accumulate;
 
-    /* Sum all numbers. Will return the total sum on rank 0
-     */
-    double accumulate(void);
+    /* Prefix sums in the global order of the summands. The inclusive prefix of index i is the sum of
+     * the first i + 1 summands exactly as accumulate computes it on a tree of that size, the exclusive
+     * prefix is the inclusive one of i - 1. Neither depends on the number of ranks. Ranks only exchange
+     * the subtrees that end at their boundaries, within log2 of the cluster size rounds. Returns the
+     * prefix of every local summand */
+    vector<double> scan(const bool inclusive = true);
+
+    /* Prefix of the whole rank, the sum of all summands before its first one or, if inclusive, up to
+     * and including its last one. Cheaper than scan, since only complete local subtrees are summed */
+    double rankPrefix(const bool inclusive = false);
+
+    /* Sum contiguous segments of the global summands, for example the partitions of an alignment.
+     * Segment i covers [boundaries[i], boundaries[i + 1]) and is summed along its own tree, as if its
+     * first summand had index 0, so its sum equals accumulate on that segment alone. The total is the
+     * one of accumulate. All segments share a single exchange, both results are returned on all ranks */
+    SegmentSums accumulate_segments(const vector<uint64_t> &boundaries);
+
+    /* Select the instructions used to sum local blocks, by default the fastest one the CPU supports.
+     * All variants give the same result */
+    void setKernel(const KernelVariant variant);
+    const AccumulationKernel& getKernel(void) const;
 
     /* Calculate all rank-intersecting summands that must be sent out because
      * their parent is non-local and located on another rank
@@ -86,8 +583,6 @@ public:
     double recursiveAccumulate(const uint64_t index);
     double nocheckAccumulate(void);
 
-    const void printStats(void) const;
-
     const int rankFromIndexClosedForm(const uint64_t index) const;
 
 protected:
@@ -99,6 +594,16 @@ protected:
     const bool is_local_subtree_of_size(const uint64_t expectedSubtreeSize, const uint64_t i) const;
     const double accumulate_local_8subtree(const uint64_t startIndex) const;
 
+    /** Grow the scratch memory to hold at least that many values if necessary */
+    double *reserveAccumulationBuffer(const uint64_t elements);
+
+    /** Decompose the local summands [first, last) into the largest complete subtrees of a tree whose
+     * first leaf is origin */
+    ScanBlocks localScanBlocks(const uint64_t first, const uint64_t last, const uint64_t origin = 0);
+
+    /** Combine the subtrees of all lower ranks, which decompose all summands before the first local one */
+    ScanBlocks precedingScanBlocks(const ScanBlocks &local) const;
+
     inline const double sum_remaining_8tree(const uint64_t bufferStartIndex,
             const uint64_t initialRemainingElements,
             const int y,
@@ -126,7 +631,7 @@ protected:
                     dstBuffer[elementsWritten++] = a;
                 } else {
                     // indexB must be fetched from another rank
-                    const double b = messageBuffer.get(rankFromIndexMap(indexB), indexB);
+                    const double b = messageBuffer->get(rankFromIndexMap(indexB), plan.remotePosition(indexB));
                     dstBuffer[elementsWritten++] = a + b;
                 }
 
@@ -143,15 +648,13 @@ protected:
 
 
 private:
-    const uint64_t size,  begin, end;
     const vector<uint64_t> rankIntersectingSummands;
     const int nonResidualRanks;
     const uint64_t fairShare, splitIndex;
-    static vector<double, Util::AlignedAllocator<double>> accumulationBuffer;
+    /* Scratch memory of the multi-pass accumulate(index), owned by the instance so that several
+     * trees can reduce concurrently. Replaying the plan does not need it. */
+    vector<double, Util::AlignedAllocator<double>> accumulationBuffer;
     std::chrono::duration<double> acquisitionDuration;
     std::map<uint64_t, int> startIndices;
     long int acquisitionCount;
-
-
-    MessageBuffer messageBuffer;
 };
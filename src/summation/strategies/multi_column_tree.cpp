@@ -0,0 +1,393 @@
+#include "multi_column_tree.hpp"
+#include "tree_kernels.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <memory>
+#include <numeric>
+
+using std::map;
+using std::unique_ptr;
+
+/* Messages are matched by their sequence number, like with TransportMode::PERSISTENT, on a duplicate
+ * of the communicator */
+const int MULTICOLUMN_MPI_TAG = 1;
+
+/** Rows of a chunk hold at most 2^CHUNK_VALUES_LEVEL values */
+static const int CHUNK_VALUES_LEVEL = 10;
+
+/** Number of values a rank sums per pipeline step of allreduce */
+static const int ALLREDUCE_CHUNK_VALUES = 1 << 15;
+
+MultiColumnTreeSummation::MultiColumnTreeSummation(uint64_t rank, vector<int> &n_summands, const int columns,
+        MPI_Comm comm)
+    : rank(rank),
+      columns(columns),
+      stride(columns < 4 ? columns : (columns + 3) & ~3),
+      n_summands(n_summands),
+      comm(Util::duplicate(comm)),
+      plan(rank, n_summands),
+      summands(static_cast<uint64_t>(n_summands[rank]) * stride),
+      chunkLevel(0),
+      blockValues(plan.operations.size() * stride),
+      accumulator(stride),
+      sendBuffer(plan.outgoingMessages.empty() ? 0
+              : (plan.outgoingMessages.back().first + plan.outgoingMessages.back().count) * columns),
+      receiveBuffer(plan.incomingIndices.size() * columns),
+      sendRequests(plan.outgoingMessages.size()),
+      receiveRequests(plan.incomingMessages.size()),
+      received(plan.incomingMessages.size()),
+      incomingEntries(plan.remoteValueCount),
+      sentEntries(0),
+      startedMessages(0) {
+    assert(columns >= 1);
+
+    rootRank = plan.rankFromIndex(0);
+
+    while ((static_cast<uint64_t>(stride) << (chunkLevel + 1)) <= (1UL << CHUNK_VALUES_LEVEL)) {
+        chunkLevel++;
+    }
+    chunkBuffer.resize(std::max(1UL << chunkLevel, 2UL) / 2 * stride);
+    pending.resize(64 * stride);
+
+    for (size_t i = 0; i < plan.outgoingMessages.size(); i++) {
+        const PlanMessage &m = plan.outgoingMessages[i];
+        MPI_Send_init(&sendBuffer[m.first * columns], m.count * columns, MPI_DOUBLE, m.peer,
+                MULTICOLUMN_MPI_TAG + m.sequence, this->comm, &sendRequests[i]);
+    }
+
+    for (size_t i = 0; i < plan.incomingMessages.size(); i++) {
+        const PlanMessage &m = plan.incomingMessages[i];
+        MPI_Recv_init(&receiveBuffer[m.first * columns], m.count * columns, MPI_DOUBLE, m.peer,
+                MULTICOLUMN_MPI_TAG + m.sequence, this->comm, &receiveRequests[i]);
+
+        for (uint32_t entry = m.first; entry < m.first + m.count; entry++) {
+            incomingEntries[plan.incomingPositions[entry]] = entry;
+            entryMessage.push_back(i);
+        }
+    }
+}
+
+MultiColumnTreeSummation::~MultiColumnTreeSummation() {
+    int finalized;
+    MPI_Finalized(&finalized);
+    if (finalized) return;
+
+    for (MPI_Request &r : sendRequests) MPI_Request_free(&r);
+    for (MPI_Request &r : receiveRequests) MPI_Request_free(&r);
+
+    int initialized;
+    MPI_Initialized(&initialized);
+    if (initialized) {
+        MPI_Comm_free(&comm);
+    }
+}
+
+void MultiColumnTreeSummation::distribute(vector<double> &values) {
+    vector<double> rows(static_cast<uint64_t>(n_summands[rank]) * columns);
+
+    if (n_summands.size() == 1) {
+        // MPI-less variant for testing
+        assert(values.size() >= rows.size());
+        std::copy(values.begin(), values.begin() + rows.size(), rows.begin());
+    } else {
+        vector<int> sendCounts;
+        vector<int> displacements;
+        int displacement = 0;
+        for (const int n : n_summands) {
+            sendCounts.push_back(n * columns);
+            displacements.push_back(displacement);
+            displacement += n * columns;
+        }
+
+        MPI_Scatterv(values.data(), &sendCounts[0], &displacements[0], MPI_DOUBLE,
+                rows.data(), rows.size(), MPI_DOUBLE, 0, comm);
+    }
+
+    setSummands(rows);
+}
+
+vector<double> MultiColumnTreeSummation::getSummands() const {
+    vector<double> rows;
+    for (uint64_t i = 0; i < static_cast<uint64_t>(n_summands[rank]); i++) {
+        rows.insert(rows.end(), &summands[i * stride], &summands[i * stride] + columns);
+    }
+
+    return rows;
+}
+
+void MultiColumnTreeSummation::setSummands(const vector<double> &values) {
+    assert(values.size() == static_cast<uint64_t>(n_summands[rank]) * columns);
+
+    std::fill(summands.begin(), summands.end(), 0.0);
+    for (uint64_t i = 0; i < static_cast<uint64_t>(n_summands[rank]); i++) {
+        std::copy(&values[i * columns], &values[i * columns] + columns, &summands[i * stride]);
+    }
+}
+
+vector<double> MultiColumnTreeSummation::accumulate() {
+    vector<double> result = replayPlan();
+
+    MPI_Bcast(&result[0], columns, MPI_DOUBLE, rootRank, comm);
+
+    return result;
+}
+
+vector<double> MultiColumnTreeSummation::replayPlan() {
+    vector<double> result(columns, 0.0);
+
+    sentEntries = 0;
+    startedMessages = 0;
+    std::fill(received.begin(), received.end(), false);
+    if (!receiveRequests.empty()) {
+        MPI_Startall(receiveRequests.size(), &receiveRequests[0]);
+    }
+
+    for (const PlanSubtree &subtree : plan.subtrees) {
+        const uint32_t lastOperation = subtree.firstOperation + subtree.operationCount;
+
+        // Local blocks do not depend on other ranks, so compute them before waiting for any message
+        for (uint32_t i = subtree.firstOperation; i < lastOperation; i++) {
+            const PlanOperation &op = plan.operations[i];
+            if (op.type == PlanOperation::LOCAL_BLOCK) {
+                accumulate_block(op.index, op.level, &blockValues[i * stride]);
+            }
+        }
+
+        const double *leaf = &summands[(subtree.lastLocalIndex - plan.begin) * stride];
+        std::copy(leaf, leaf + columns, accumulator.begin());
+
+        // Same additions as BinaryTreeSummation::climbSpine, for every column
+        for (uint32_t i = subtree.firstOperation; i < lastOperation; i++) {
+            const PlanOperation &op = plan.operations[i];
+
+            if (op.type == PlanOperation::LOCAL_BLOCK) {
+                const double *block = &blockValues[i * stride];
+                for (int k = 0; k < columns; k++) {
+                    accumulator[k] = block[k] + accumulator[k];
+                }
+            } else {
+                const double *remote = get(op.index);
+                for (int k = 0; k < columns; k++) {
+                    accumulator[k] = accumulator[k] + remote[k];
+                }
+            }
+        }
+
+        if (subtree.targetRank < 0) {
+            std::copy(accumulator.begin(), accumulator.begin() + columns, result.begin());
+        } else {
+            put(&accumulator[0]);
+        }
+    }
+
+    assert(startedMessages == plan.outgoingMessages.size());
+    if (!sendRequests.empty()) {
+        MPI_Waitall(sendRequests.size(), &sendRequests[0], MPI_STATUSES_IGNORE);
+    }
+
+    return result;
+}
+
+void MultiColumnTreeSummation::put(const double *values) {
+    std::copy(values, values + columns, &sendBuffer[sentEntries * columns]);
+    sentEntries++;
+
+    // Subtrees are computed in the order of their entries, so a message is complete with its last entry
+    const PlanMessage &m = plan.outgoingMessages[startedMessages];
+    if (sentEntries == m.first + m.count) {
+        MPI_Start(&sendRequests[startedMessages]);
+        startedMessages++;
+    }
+}
+
+const double *MultiColumnTreeSummation::get(const uint64_t index) {
+    const uint32_t entry = incomingEntries[plan.remotePosition(index)];
+    const uint32_t message = entryMessage[entry];
+
+    if (!received[message]) {
+        MPI_Wait(&receiveRequests[message], MPI_STATUS_IGNORE);
+        received[message] = true;
+    }
+
+    return &receiveBuffer[entry * columns];
+}
+
+void MultiColumnTreeSummation::accumulate_block(const uint64_t startIndex, const int level, double *result) {
+    const double *source = &summands[(startIndex - plan.begin) * stride];
+
+    if (level <= chunkLevel) {
+        accumulate_chunk(source, level, result);
+        return;
+    }
+
+    // Fold the chunk sums like a binary counter, see BinaryTreeSummation::stream_block
+    int pendingCount = 0;
+    const uint64_t chunks = 1UL << (level - chunkLevel);
+    for (uint64_t c = 0; c < chunks; c++) {
+        double *value = &pending[pendingCount * stride];
+        accumulate_chunk(source + (c << chunkLevel) * stride, chunkLevel, value);
+
+        for (uint64_t carry = c; carry & 1; carry >>= 1) {
+            pendingCount--;
+            double *left = &pending[pendingCount * stride];
+            for (int k = 0; k < stride; k++) {
+                left[k] = left[k] + value[k];
+            }
+            value = left;
+        }
+
+        pendingCount++;
+    }
+
+    assert(pendingCount == 1);
+    std::copy(pending.begin(), pending.begin() + stride, result);
+}
+
+void MultiColumnTreeSummation::accumulate_chunk(const double *source, const int level, double *result) {
+    assert(level <= chunkLevel);
+
+    if (level == 0) {
+        std::copy(source, source + stride, result);
+        return;
+    }
+
+    // The first level reads from the summands, all others stay within the buffer
+    uint64_t rows = 1UL << (level - 1);
+    TreeKernels::reduce_rows(source, &chunkBuffer[0], rows, stride);
+
+    while (rows > 1) {
+        rows /= 2;
+        TreeKernels::reduce_rows(&chunkBuffer[0], &chunkBuffer[0], rows, stride);
+    }
+
+    std::copy(chunkBuffer.begin(), chunkBuffer.begin() + stride, result);
+}
+
+const ReductionPlan& MultiColumnTreeSummation::getPlan() const {
+    return plan;
+}
+
+int MultiColumnTreeSummation::getColumns() const {
+    return columns;
+}
+
+void MultiColumnTreeSummation::allreduce(const double *rows, const int localRows, const int columns,
+        double *result, MPI_Comm comm) {
+    int rank, commSize;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &commSize);
+
+    vector<int> n_rows(commSize);
+    MPI_Allgather(&localRows, 1, MPI_INT, &n_rows[0], 1, MPI_INT, comm);
+    const int totalRows = std::accumulate(n_rows.begin(), n_rows.end(), 0);
+
+    if (columns == 0) return;
+
+    // Rank r sums the columns [sliceStart[r], sliceStart[r + 1])
+    vector<int> sliceStart(commSize + 1);
+    for (int r = 0; r <= commSize; r++) {
+        sliceStart[r] = static_cast<uint64_t>(columns) * r / commSize;
+    }
+    const int widestSlice = (columns + commSize - 1) / commSize;
+
+    int chunkWidth = std::max(1, ALLREDUCE_CHUNK_VALUES / std::max(totalRows, 1));
+    if (chunkWidth >= 4) chunkWidth &= ~3;
+    const int chunkCount = (widestSlice + chunkWidth - 1) / chunkWidth;
+
+    // Columns of the slice of rank r that belong to a chunk
+    const auto width = [&] (const int r, const int chunk) {
+        const int remaining = sliceStart[r + 1] - sliceStart[r] - chunk * chunkWidth;
+        return std::clamp(remaining, 0, chunkWidth);
+    };
+
+    // Two sets of buffers, one chunk is exchanged while the previous one is summed
+    vector<double> sendBuffer[2];
+    vector<double> receiveBuffer[2];
+    vector<int> sendCounts[2], sendDisplacements[2], receiveCounts[2], receiveDisplacements[2];
+    MPI_Request exchangeRequests[2];
+    vector<MPI_Request> gatherRequests(chunkCount);
+    vector<int> gatherCounts(static_cast<uint64_t>(chunkCount) * commSize);
+    vector<int> gatherDisplacements(static_cast<uint64_t>(chunkCount) * commSize);
+
+    const auto startExchange = [&] (const int chunk) {
+        const int b = chunk % 2;
+        sendCounts[b].assign(commSize, 0);
+        sendDisplacements[b].assign(commSize, 0);
+        receiveCounts[b].assign(commSize, 0);
+        receiveDisplacements[b].assign(commSize, 0);
+        sendBuffer[b].clear();
+
+        for (int r = 0; r < commSize; r++) {
+            const int columnOffset = sliceStart[r] + chunk * chunkWidth;
+            const int w = width(r, chunk);
+
+            sendDisplacements[b][r] = sendBuffer[b].size();
+            sendCounts[b][r] = localRows * w;
+            for (int i = 0; i < localRows; i++) {
+                const double *row = &rows[static_cast<uint64_t>(i) * columns + columnOffset];
+                sendBuffer[b].insert(sendBuffer[b].end(), row, row + w);
+            }
+        }
+
+        // Rows arrive ordered by rank, which is their global order
+        const int w = width(rank, chunk);
+        for (int r = 0, displacement = 0; r < commSize; r++) {
+            receiveDisplacements[b][r] = displacement;
+            receiveCounts[b][r] = n_rows[r] * w;
+            displacement += n_rows[r] * w;
+        }
+        receiveBuffer[b].resize(static_cast<uint64_t>(totalRows) * w);
+
+        MPI_Ialltoallv(sendBuffer[b].data(), &sendCounts[b][0], &sendDisplacements[b][0], MPI_DOUBLE,
+                receiveBuffer[b].data(), &receiveCounts[b][0], &receiveDisplacements[b][0], MPI_DOUBLE,
+                comm, &exchangeRequests[b]);
+    };
+
+    /* All chunks of a slice but the last one are equally wide, so at most two trees sum every chunk of
+     * this rank. They are set up once instead of per chunk */
+    vector<int> n_summands { totalRows };
+    map<int, unique_ptr<MultiColumnTreeSummation>> trees;
+    for (int chunk = 0; chunk < chunkCount && totalRows > 0; chunk++) {
+        const int w = width(rank, chunk);
+        if (w > 0 && trees.count(w) == 0) {
+            trees[w] = std::make_unique<MultiColumnTreeSummation>(0, n_summands, w, MPI_COMM_SELF);
+        }
+    }
+
+    startExchange(0);
+    for (int chunk = 0; chunk < chunkCount; chunk++) {
+        if (chunk + 1 < chunkCount) {
+            startExchange(chunk + 1);
+        }
+
+        const int b = chunk % 2;
+        MPI_Wait(&exchangeRequests[b], MPI_STATUS_IGNORE);
+
+        const int w = width(rank, chunk);
+        double *sums = &result[sliceStart[rank] + chunk * chunkWidth];
+        if (w > 0 && totalRows > 0) {
+            MultiColumnTreeSummation &tree = *trees.at(w);
+            tree.setSummands(receiveBuffer[b]);
+
+            const vector<double> chunkSums = tree.replayPlan();
+            std::copy(chunkSums.begin(), chunkSums.end(), sums);
+        } else {
+            std::fill(sums, sums + w, 0.0);
+        }
+
+        int *counts = &gatherCounts[static_cast<uint64_t>(chunk) * commSize];
+        int *displacements = &gatherDisplacements[static_cast<uint64_t>(chunk) * commSize];
+        for (int r = 0; r < commSize; r++) {
+            counts[r] = width(r, chunk);
+            displacements[r] = sliceStart[r] + chunk * chunkWidth;
+        }
+
+        MPI_Iallgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, result, counts, displacements, MPI_DOUBLE,
+                comm, &gatherRequests[chunk]);
+    }
+
+    MPI_Waitall(chunkCount, &gatherRequests[0], MPI_STATUSES_IGNORE);
+}
@@ -0,0 +1,101 @@
+#ifndef MULTI_COLUMN_TREE_HPP_
+#define MULTI_COLUMN_TREE_HPP_
+
+#include "reduction_plan.hpp"
+#include <cstdint>
+#include <vector>
+#include <mpi.h>
+
+using std::vector;
+
+/* Sums several series that share the same distribution along the same tree, for example the
+ * log-likelihood of every site together with its derivatives. The values of a site form a row, so every
+ * addition of the tree adds whole rows. Each column gives exactly the same result as a
+ * BinaryTreeSummation of that column alone, but the plan, and with it the number of messages, is the
+ * one of a single series. Every entry of a message carries the values of all columns. */
+class MultiColumnTreeSummation {
+public:
+    /**
+     * @param rank The rank of the currently running executable
+     * @param n_summands Number of rows on each rank
+     * @param columns Number of values per row
+     */
+    MultiColumnTreeSummation(uint64_t rank, vector<int> &n_summands, const int columns,
+            MPI_Comm comm = MPI_COMM_WORLD);
+
+    ~MultiColumnTreeSummation();
+
+    /* Distribute the rows across the cluster. The values are stored row after row and only need to be
+     * valid on the root rank */
+    void distribute(vector<double> &values);
+
+    /* Local rows, stored row after row */
+    vector<double> getSummands(void) const;
+    void setSummands(const vector<double> &values);
+
+    /* Sum every column, the sums are returned on all ranks */
+    vector<double> accumulate(void);
+
+    /* Replay the reduction plan, the sums are returned on the rank with the first row */
+    vector<double> replayPlan(void);
+
+    const ReductionPlan& getPlan(void) const;
+    int getColumns(void) const;
+
+    /* Reproducible replacement for MPI_Allreduce with MPI_SUM on vectors of doubles. Every rank
+     * contributes localRows vectors of the given length, stored one after another, and all ranks receive
+     * their element-wise sum. Each element is summed along the tree over the global sequence of vectors,
+     * so the result does not depend on how the vectors are spread across the ranks.
+     *
+     * Like a reduce-scatter followed by an allgather, every rank sums one slice of the columns, so each
+     * rank sends and receives about as many values as the vectors are long. Slices are exchanged in
+     * chunks, the next chunk is in flight while the current one is summed.
+     *
+     * result must not overlap with rows */
+    static void allreduce(const double *rows, const int localRows, const int columns, double *result,
+            MPI_Comm comm = MPI_COMM_WORLD);
+
+protected:
+    /** Sum a complete block of 2^level local rows in tree order into result */
+    void accumulate_block(const uint64_t startIndex, const int level, double *result);
+
+    /** Sum a complete block of at most 2^chunkLevel rows */
+    void accumulate_chunk(const double *source, const int level, double *result);
+
+    /** Copy a computed subtree into its outgoing message and start the message once it is complete */
+    void put(const double *values);
+
+    /** Wait for the message containing a remote value, returns its columns */
+    const double *get(const uint64_t index);
+
+    const int rank;
+    const int columns;
+    /* Wider rows are padded to a multiple of four values, so every addition is a full vector */
+    const int stride;
+    const vector<int> n_summands;
+    MPI_Comm comm;     // duplicate of the communicator passed to the constructor
+    const ReductionPlan plan;
+    int rootRank;
+
+    vector<double> summands;
+
+    /* Blocks are streamed in chunks that fit into L1 */
+    int chunkLevel;
+    vector<double> chunkBuffer;
+    vector<double> pending;
+    vector<double> blockValues;
+    vector<double> accumulator;
+
+    /* Messages are laid out by the plan, like with TransportMode::PERSISTENT */
+    vector<double> sendBuffer;
+    vector<double> receiveBuffer;
+    vector<MPI_Request> sendRequests;
+    vector<MPI_Request> receiveRequests;
+    vector<bool> received;
+    vector<uint32_t> incomingEntries;   // entry of every remote value in the incoming messages
+    vector<uint32_t> entryMessage;      // incoming message of every entry
+    uint32_t sentEntries;
+    uint32_t startedMessages;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include "progress_thread.hpp"
+
+#include <cassert>
+
+ProgressThread::ProgressThread(std::function<void(void)> progress)
+    : progress(progress),
+      phase(IDLE),
+      stepCount(0),
+      thread(&ProgressThread::run, this) {
+}
+
+ProgressThread::~ProgressThread() {
+    assert(phase.load() == IDLE);
+
+    phase.store(STOPPING);
+    phase.notify_one();
+    thread.join();
+}
+
+void ProgressThread::handOff() {
+    // Release everything the owner has written, so the progress thread continues where it left off
+    phase.store(HANDED_OFF, std::memory_order_release);
+    phase.notify_one();
+}
+
+void ProgressThread::reclaim() {
+    phase.store(RECLAIMING, std::memory_order_release);
+    phase.notify_one();
+
+    // The progress thread acknowledges by resetting the phase once it is no longer communicating
+    int current = RECLAIMING;
+    while (current != IDLE) {
+        phase.wait(current, std::memory_order_acquire);
+        current = phase.load(std::memory_order_acquire);
+    }
+}
+
+unsigned long ProgressThread::steps() const {
+    return stepCount.load(std::memory_order_relaxed);
+}
+
+void ProgressThread::run() {
+    while (true) {
+        const int current = phase.load(std::memory_order_acquire);
+
+        if (current == IDLE) {
+            phase.wait(IDLE, std::memory_order_acquire);
+        } else if (current == HANDED_OFF) {
+            progress();
+            stepCount.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+        } else if (current == RECLAIMING) {
+            phase.store(IDLE, std::memory_order_release);
+            phase.notify_one();
+        } else {
+            return;
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef PROGRESS_THREAD_HPP_
+#define PROGRESS_THREAD_HPP_
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+/** Drives communication while the owning thread is busy computing. The owner hands the communication
+ * over with handOff and takes it back with reclaim, in between only the progress thread calls the
+ * progress function. Since the two threads never communicate at the same time, MPI_THREAD_SERIALIZED
+ * is sufficient. */
+class ProgressThread {
+public:
+    ProgressThread(std::function<void(void)> progress);
+    ~ProgressThread();
+
+    ProgressThread(const ProgressThread &) = delete;
+    ProgressThread& operator=(const ProgressThread &) = delete;
+
+    /** Let the progress thread call the progress function repeatedly until reclaim is called */
+    void handOff(void);
+
+    /** Wait until the progress thread has returned from the progress function */
+    void reclaim(void);
+
+    /** Number of times the progress function has been called */
+    unsigned long steps(void) const;
+
+protected:
+    enum Phase {
+        IDLE,           // the owner communicates, the progress thread sleeps
+        HANDED_OFF,     // the progress thread communicates
+        RECLAIMING,     // the owner waits for the progress thread to finish its step
+        STOPPING
+    };
+
+    void run(void);
+
+    std::function<void(void)> progress;
+    std::atomic<int> phase;
+    std::atomic<unsigned long> stepCount;
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,326 @@
+#include "reduction_plan.hpp"
+#include "binary_tree.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+ReductionPlan::ReductionPlan(const int rank, const vector<int> &n_summands, const bool withIncomingMessages,
+        const bool rootOnAllRanks, const SendSchedule sendSchedule)
+    // The simulation plans every rank with the other schedule, which does not depend on any timing
+    : ReductionPlan(rank, n_summands, withIncomingMessages, rootOnAllRanks, sendSchedule,
+            (sendSchedule == SendSchedule::CRITICAL_PATH && n_summands[rank] > 0)
+                ? simulate(n_summands, rootOnAllRanks, SendSchedule::LOCAL_WORK, false)
+                : map<uint64_t, SubtreeTiming>()) {
+}
+
+ReductionPlan::ReductionPlan(const int rank, const vector<int> &n_summands, const bool withIncomingMessages,
+        const bool rootOnAllRanks, const SendSchedule sendSchedule, const map<uint64_t, SubtreeTiming> &timings)
+    : globalSize(std::accumulate(n_summands.begin(), n_summands.end(), 0UL)),
+      remoteValueCount(0),
+      withIncomingMessages(withIncomingMessages),
+      roundCount(0),
+      largestBlockSize(0),
+      largestIncomingMessage(0) {
+    startIndices.reserve(n_summands.size());
+
+    uint64_t startIndex = 0;
+    for (const int n : n_summands) {
+        startIndices.push_back(startIndex);
+        startIndex += n;
+    }
+
+    begin = startIndices[rank];
+    end = begin + n_summands[rank];
+
+    if (begin == end) {
+        // Nothing to do for a rank without summands
+        return;
+    }
+
+    if (begin == 0) {
+        // The rank with the first summand computes the root of the tree
+        if (!rootOnAllRanks) {
+            int levels = 0;
+            while ((1UL << levels) < globalSize) levels++;
+
+            addSubtree(0, globalSize, levels, -1);
+        }
+    } else {
+        /* Every other rank computes the subtrees of its rank-intersecting summands, see
+         * BinaryTreeSummation::calculateRankIntersectingSummands */
+        const int rootRank = rankFromIndex(0);
+
+        for (uint64_t index = begin; index < end; index += index & (~index + 1)) {
+            const uint64_t subtreeSize = index & (~index + 1);
+            const int levels = __builtin_ctzl(subtreeSize);
+            const int targetRank = rankFromIndex(BinaryTreeSummation::parent(index));
+
+            // Subtrees sent to the root rank are the inputs of the root
+            addSubtree(index, std::min(index + subtreeSize, globalSize), levels,
+                    (rootOnAllRanks && targetRank == rootRank) ? PlanSubtree::TOP_LEVEL : targetRank);
+        }
+    }
+
+    groupOutgoingMessages(n_summands, sendSchedule, timings);
+
+    if (withIncomingMessages) {
+        calculateIncomingMessages(rank, n_summands, rootOnAllRanks, sendSchedule, timings);
+
+        map<uint64_t, uint32_t> rounds;
+        for (PlanSubtree &subtree : subtrees) {
+            subtree.round = 0;
+            for (uint32_t i = subtree.firstOperation; i < subtree.firstOperation + subtree.operationCount; i++) {
+                if (operations[i].type == PlanOperation::REMOTE_VALUE) {
+                    subtree.round = std::max(subtree.round, subtreeRound(operations[i].index, rounds) + 1);
+                }
+            }
+            roundCount = std::max(roundCount, subtree.round + 1);
+        }
+
+        for (const uint64_t index : incomingIndices) {
+            incomingRounds.push_back(subtreeRound(index, rounds));
+        }
+    }
+}
+
+int ReductionPlan::rankFromIndex(const uint64_t index) const {
+    assert(index < globalSize);
+
+    // Ranks without summands share their start index with the next rank, upper_bound skips them
+    auto it = std::upper_bound(startIndices.begin(), startIndices.end(), index);
+    return static_cast<int>(it - startIndices.begin()) - 1;
+}
+
+uint32_t ReductionPlan::subtreeRound(const uint64_t index, map<uint64_t, uint32_t> &rounds) const {
+    const auto it = rounds.find(index);
+    if (it != rounds.end()) return it->second;
+
+    // Walk up the spine of the subtree like addSubtree does on the rank that owns it
+    const int owner = rankFromIndex(index);
+    const uint64_t ownerEnd = (owner + 1 < static_cast<int>(startIndices.size())) ? startIndices[owner + 1]
+        : globalSize;
+    const uint64_t subtreeSize = index & (~index + 1);
+    const uint64_t offset = std::min(std::min(index + subtreeSize, globalSize), ownerEnd) - 1 - index;
+
+    uint32_t round = 0;
+    for (int k = 0; (1UL << k) < subtreeSize; k++) {
+        if ((offset >> k) & 1) continue;
+
+        const uint64_t siblingIndex = index + ((offset >> k) << k) + (1UL << k);
+        if (siblingIndex < globalSize) {
+            round = std::max(round, subtreeRound(siblingIndex, rounds) + 1);
+        }
+    }
+
+    rounds[index] = round;
+    return round;
+}
+
+void ReductionPlan::addSubtree(const uint64_t index, const uint64_t subtreeEnd, const int levels,
+        const int targetRank) {
+    PlanSubtree subtree;
+    subtree.index = index;
+    subtree.lastLocalIndex = std::min(end, subtreeEnd) - 1;
+    subtree.firstOperation = operations.size();
+    subtree.targetRank = targetRank;
+    subtree.flushBefore = false;
+    subtree.round = 0;
+
+    // Offset of the leaf where the spine starts, relative to the subtree root
+    const uint64_t offset = subtree.lastLocalIndex - index;
+
+    for (int k = 0; k < levels; k++) {
+        // Offset of the spine node on level k
+        const uint64_t nodeOffset = (offset >> k) << k;
+
+        PlanOperation op;
+        op.level = k;
+
+        if ((offset >> k) & 1) {
+            // The spine node is a right child, its left sibling consists of local summands only
+            op.type = PlanOperation::LOCAL_BLOCK;
+            op.rank = -1;
+            op.position = 0;
+            op.index = index + nodeOffset - (1UL << k);
+
+            largestBlockSize = std::max(largestBlockSize, 1UL << k);
+        } else {
+            // The spine node is a left child, its right sibling (if any) is located on another rank
+            const uint64_t siblingIndex = index + nodeOffset + (1UL << k);
+            if (siblingIndex >= globalSize) continue;
+
+            assert(siblingIndex >= end);
+
+            // Waiting for a remote value must not hold back results that are already computed
+            subtree.flushBefore = true;
+
+            op.type = PlanOperation::REMOTE_VALUE;
+            op.rank = rankFromIndex(siblingIndex);
+            op.position = remoteValueCount++;
+            op.index = siblingIndex;
+
+            assert(remoteIndices.empty() || remoteIndices.back() < siblingIndex);
+            remoteIndices.push_back(siblingIndex);
+        }
+
+        operations.push_back(op);
+    }
+
+    subtree.operationCount = operations.size() - subtree.firstOperation;
+    subtrees.push_back(subtree);
+}
+
+map<uint64_t, SubtreeTiming> ReductionPlan::simulate(const vector<int> &n_summands, const bool rootOnAllRanks,
+        const SendSchedule sendSchedule, const bool grouped, const double sendCost) {
+    map<uint64_t, SubtreeTiming> timings;
+    map<uint64_t, double> arrivals;
+
+    // Remote values always come from ranks further right, so these are simulated first
+    for (int rank = static_cast<int>(n_summands.size()) - 1; rank >= 0; rank--) {
+        if (n_summands[rank] == 0) continue;
+
+        const ReductionPlan plan(rank, n_summands, false, rootOnAllRanks, sendSchedule);
+        double time = 0.0;
+
+        for (const PlanSubtree &subtree : plan.subtrees) {
+            const PlanOperation *first = &plan.operations[subtree.firstOperation];
+            const PlanOperation *last = first + subtree.operationCount;
+
+            // Like BinaryTreeSummation::startSubtree, all local blocks are summed before climbing the spine
+            for (const PlanOperation *op = first; op != last; op++) {
+                if (op->type == PlanOperation::LOCAL_BLOCK) {
+                    time += (1UL << op->level) - 1;
+                }
+            }
+
+            for (const PlanOperation *op = first; op != last; op++) {
+                if (op->type == PlanOperation::REMOTE_VALUE) {
+                    timings[op->index].needed = time;
+                    time = std::max(time, arrivals[op->index]);
+                }
+                time += 1.0;
+            }
+
+            timings[subtree.index].completed = time;
+        }
+
+        // Subtrees that are sent, in the order of their entries
+        vector<uint64_t> sentIndices;
+        for (const PlanSubtree &subtree : plan.subtrees) {
+            if (subtree.targetRank < 0) continue;
+
+            sentIndices.push_back(subtree.index);
+            arrivals[subtree.index] = timings[subtree.index].completed + sendCost;
+        }
+
+        if (grouped) {
+            // A message is sent once its last entry is complete
+            for (const PlanMessage &message : plan.outgoingMessages) {
+                const double arrival = arrivals[sentIndices[message.first + message.count - 1]];
+                for (uint32_t i = message.first; i < message.first + message.count; i++) {
+                    arrivals[sentIndices[i]] = arrival;
+                }
+            }
+        }
+    }
+
+    return timings;
+}
+
+void ReductionPlan::groupOutgoingMessages(const vector<int> &n_summands, const SendSchedule sendSchedule,
+        const map<uint64_t, SubtreeTiming> &timings) {
+    uint32_t entry = 0;
+    bool messageOpen = false;
+    uint64_t messageIndex = 0;      // index of the first subtree in the open message
+    vector<uint32_t> messagesTo(n_summands.size(), 0);
+
+    for (PlanSubtree &subtree : subtrees) {
+        if (subtree.targetRank < 0) continue;
+
+        /* Subtrees that wait for other ranks always start a new message, since we cannot know when they
+         * are completed. Any other subtree can be added to the open message if that does not delay its
+         * receiver. With SendSchedule::LOCAL_WORK, the receiver is assumed to consume remote values once
+         * it has summed all of its own numbers. Assuming that both ranks start at the same time and sum
+         * equally fast, the subtree must be complete by then. SendSchedule::CRITICAL_PATH takes the
+         * time from the simulation instead, which also accounts for the receiver waiting on other ranks
+         * and for the time it takes to send the message. */
+        bool delaysReceiver;
+        if (sendSchedule == SendSchedule::CRITICAL_PATH) {
+            delaysReceiver = messageOpen
+                && timings.at(subtree.index).completed + SEND_COST > timings.at(messageIndex).needed;
+        } else {
+            const uint64_t subtreeEnd = std::min(subtree.index + (subtree.index & (~subtree.index + 1)), end);
+            const uint64_t completedWork = subtreeEnd - begin;
+            delaysReceiver = completedWork > static_cast<uint64_t>(n_summands[subtree.targetRank]);
+        }
+
+        if (messageOpen && (subtree.flushBefore
+                    || outgoingMessages.back().peer != subtree.targetRank
+                    || delaysReceiver)) {
+            messageOpen = false;
+        }
+
+        if (!messageOpen) {
+            outgoingMessages.push_back(PlanMessage { subtree.targetRank, entry, 0,
+                    messagesTo[subtree.targetRank]++ });
+            subtree.flushBefore = true;
+            messageOpen = true;
+            messageIndex = subtree.index;
+        }
+
+        outgoingMessages.back().count++;
+        entry++;
+    }
+}
+
+uint32_t ReductionPlan::remotePosition(const uint64_t index) const {
+    const auto it = std::lower_bound(remoteIndices.begin(), remoteIndices.end(), index);
+    assert(it != remoteIndices.end() && *it == index);
+    return it - remoteIndices.begin();
+}
+
+uint32_t ReductionPlan::messageCapacity(const int targetRank) const {
+    uint32_t capacity = 0;
+    for (const PlanMessage &message : outgoingMessages) {
+        if (message.peer == targetRank) {
+            capacity = std::max(capacity, message.count);
+        }
+    }
+
+    return capacity;
+}
+
+void ReductionPlan::calculateIncomingMessages(const int rank, const vector<int> &n_summands,
+        const bool rootOnAllRanks, const SendSchedule sendSchedule, const map<uint64_t, SubtreeTiming> &timings) {
+    vector<int> sourceRanks;
+    for (const PlanOperation &op : operations) {
+        if (op.type == PlanOperation::REMOTE_VALUE) {
+            sourceRanks.push_back(op.rank);
+        }
+    }
+    std::sort(sourceRanks.begin(), sourceRanks.end());
+    sourceRanks.erase(std::unique(sourceRanks.begin(), sourceRanks.end()), sourceRanks.end());
+
+    /* Replay the message grouping of every rank that sends to us. The timings of the simulation cover
+     * all ranks, so they are shared instead of simulating again for every source */
+    for (const int source : sourceRanks) {
+        const ReductionPlan sourcePlan(source, n_summands, false, rootOnAllRanks, sendSchedule, timings);
+
+        for (const PlanMessage &message : sourcePlan.outgoingMessages) {
+            if (message.peer != rank) continue;
+
+            incomingMessages.push_back(PlanMessage { source,
+                    static_cast<uint32_t>(incomingIndices.size()), message.count, message.sequence });
+            largestIncomingMessage = std::max(largestIncomingMessage, message.count);
+
+            for (uint32_t i = 0; i < message.count; i++) {
+                const uint64_t index = sourcePlan.subtrees[message.first + i].index;
+                incomingIndices.push_back(index);
+                incomingPositions.push_back(remotePosition(index));
+            }
+        }
+    }
+
+    assert(incomingIndices.size() == remoteValueCount);
+}
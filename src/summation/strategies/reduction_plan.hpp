@@ -0,0 +1,159 @@
+#ifndef REDUCTION_PLAN_HPP_
+#define REDUCTION_PLAN_HPP_
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+using std::vector;
+using std::map;
+
+/** A single step along the spine of a subtree that is reduced on this rank.
+ *
+ * The spine starts at the last local leaf of the subtree and climbs up one level per step.
+ * If the sibling of the spine node is a complete block of local summands, it is added from the
+ * left, otherwise the sibling is the root of a subtree on another rank and is added from the right.
+ */
+struct PlanOperation {
+    enum Type : uint8_t {
+        LOCAL_BLOCK,
+        REMOTE_VALUE
+    };
+
+    Type type;
+    uint8_t level;      // log2 of the number of leaves below the sibling
+    int rank;           // rank that sends a remote value, -1 for local blocks
+    uint32_t position;  // position of a remote value in the order in which they are consumed
+    uint64_t index;     // index of the first leaf below the sibling
+};
+
+/** A subtree whose value is computed on this rank, either a rank-intersecting summand or the root */
+struct PlanSubtree {
+    uint64_t index;             // index of the subtree root
+    uint64_t lastLocalIndex;    // leaf where the spine starts
+    uint32_t firstOperation;
+    uint32_t operationCount;
+    int targetRank;             // rank that receives the result, -1 for the root of the whole tree and
+                                // TOP_LEVEL if it is an input of the root that all ranks compute
+    bool flushBefore;           // starts a new message, so the previous one is sent before starting on
+                                // this subtree
+    uint32_t round;             // one more than the latest round of the remote values it depends on,
+                                // zero if it only consists of local summands
+
+    static const int TOP_LEVEL = -2;
+};
+
+/** When subtrees that go to the same rank are put into a single message. LOCAL_WORK is the default:
+ * with the sizes of the data sets and up to 256 ranks, CRITICAL_PATH shortens the simulated critical
+ * path by less than 0.7%, but sends up to 3.3 times as many messages */
+enum class SendSchedule {
+    LOCAL_WORK,     // if they are complete before the receiver has summed its own numbers
+    CRITICAL_PATH   // if they are complete before the receiver needs the first value of the message,
+                    // according to ReductionPlan::simulate
+};
+
+/** Estimated point in time at which a subtree that is sent is complete and at which its receiver
+ * needs it, in additions since the start of the reduction */
+struct SubtreeTiming {
+    double completed;
+    double needed;
+};
+
+/** A message between two ranks. Entries of outgoing messages are numbered in the order in which the
+ * subtrees are sent, entries of incoming messages in the order in which they arrive. */
+struct PlanMessage {
+    int peer;           // target rank of outgoing, source rank of incoming messages
+    uint32_t first;     // first entry of the message
+    uint32_t count;     // number of entries in the message
+    uint32_t sequence;  // number of earlier messages between the same two ranks
+};
+
+class ReductionPlan {
+public:
+    /**
+     * Precompute all steps necessary for one reduction on a given rank
+     * @param rank The rank for which the plan is built
+     * @param n_summands Number of summands on each rank
+     * @param withIncomingMessages Also determine the layout of incoming messages, which requires
+     *                             building the plans of all ranks that send to this one
+     * @param rootOnAllRanks The root is computed redundantly by all ranks, so the rank with the first
+     *                       summand does not get a root subtree and the inputs of the root are not
+     *                       sent to it
+     * @param sendSchedule How subtrees are grouped into messages, must be the same on all ranks
+     */
+    ReductionPlan(const int rank, const vector<int> &n_summands, const bool withIncomingMessages = true,
+            const bool rootOnAllRanks = false, const SendSchedule sendSchedule = SendSchedule::LOCAL_WORK);
+
+    /**
+     * Estimate the course of a reduction in which every rank executes its plan in order. A subtree
+     * costs one addition per summand, every message SEND_COST additions.
+     * @param grouped Values arrive once their whole message is complete, otherwise every value is
+     *                sent on its own as soon as it is computed
+     * @return Timing of every subtree, including the root unless rootOnAllRanks is set
+     */
+    static map<uint64_t, SubtreeTiming> simulate(const vector<int> &n_summands, const bool rootOnAllRanks,
+            const SendSchedule sendSchedule, const bool grouped, const double sendCost = SEND_COST);
+
+    /** Cost of a message in additions, used to plan the send schedule */
+    static constexpr double SEND_COST = 4096.0;
+
+    /** Determine which rank has the number with a given index */
+    int rankFromIndex(const uint64_t index) const;
+
+    uint64_t globalSize;
+    uint64_t begin, end;
+
+    vector<PlanSubtree> subtrees;
+    vector<PlanOperation> operations;
+    uint32_t remoteValueCount;
+
+    /* Index of every remote value, by position. Remote values are consumed in ascending order of
+     * their index */
+    vector<uint64_t> remoteIndices;
+
+    /** Position of the remote value with the given index */
+    uint32_t remotePosition(const uint64_t index) const;
+
+    /* Both sides of every exchange know in advance how many messages of which size will be sent.
+     * Subtrees going to the same rank are put into one message unless that would make the receiver
+     * wait, see groupOutgoingMessages */
+    vector<PlanMessage> outgoingMessages;
+    vector<PlanMessage> incomingMessages;
+    vector<uint64_t> incomingIndices;
+    vector<uint32_t> incomingPositions;     // position of the remote value for every incoming entry
+    vector<uint32_t> incomingRounds;        // round in which every incoming entry is computed
+
+    /** The incoming messages and the rounds have been determined, see the constructor */
+    bool withIncomingMessages;
+
+    /** Number of rounds until all subtrees of this rank are computed. If values are only exchanged
+     * in between rounds, a subtree can be computed in its round and sent right after */
+    uint32_t roundCount;
+
+    /** Size of the largest local block, determines how much scratch memory an execution needs */
+    uint64_t largestBlockSize;
+
+    /** Largest number of entries in any outgoing message to a rank */
+    uint32_t messageCapacity(const int targetRank) const;
+
+    /** Largest number of entries in any incoming message */
+    uint32_t largestIncomingMessage;
+
+protected:
+    /** Plan with the timings of a simulation that has already been run, see calculateIncomingMessages */
+    ReductionPlan(const int rank, const vector<int> &n_summands, const bool withIncomingMessages,
+            const bool rootOnAllRanks, const SendSchedule sendSchedule, const map<uint64_t, SubtreeTiming> &timings);
+
+    void addSubtree(const uint64_t index, const uint64_t subtreeEnd, const int levels, const int targetRank);
+    void groupOutgoingMessages(const vector<int> &n_summands, const SendSchedule sendSchedule,
+            const map<uint64_t, SubtreeTiming> &timings);
+    void calculateIncomingMessages(const int rank, const vector<int> &n_summands, const bool rootOnAllRanks,
+            const SendSchedule sendSchedule, const map<uint64_t, SubtreeTiming> &timings);
+
+    /** Round of a subtree that is reduced on another rank, rounds that are already known are cached */
+    uint32_t subtreeRound(const uint64_t index, map<uint64_t, uint32_t> &rounds) const;
+
+    vector<uint64_t> startIndices;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "reproblas_summation.hpp"
+#include <cstdlib>
 #include <mpi.h>
 
 extern "C" {
@@ -10,12 +11,19 @@ extern "C" {
 
 
 double ReproBLASSummation::accumulate() {
+    double sum = accumulate_to(ROOT_RANK);
+
+    MPI_Bcast(&sum, 1, MPI_DOUBLE, ROOT_RANK, comm);
+    return sum;
+}
+
+double ReproBLASSummation::accumulate_to(const int root) {
     /* Adopted from the MPI_sum_sine.c example, line 105 onwards */
     double_binned *isum = NULL;
     double_binned *local_isum = binned_dballoc(3);
     binned_dbsetzero(3, local_isum);
 
-    if (rank == 0) {
+    if (rank == root) {
         isum = binned_dballoc(3);
         binned_dbsetzero(3, isum);
     }
@@ -24,13 +32,68 @@ double ReproBLASSummation::accumulate() {
     binnedBLAS_dbdsum(3, n_summands[rank], &summands[0], 1, local_isum);
 
     MPI_Reduce(local_isum, isum, 1, binnedMPI_DOUBLE_BINNED(3),
-            binnedMPI_DBDBADD(3), 0, comm);
+            binnedMPI_DBDBADD(3), root, comm);
 
-    double sum;
-    if (rank == 0) {
+    double sum = 0.0;
+    if (rank == root) {
         sum = binned_ddbconv(3, isum);
     }
 
-    MPI_Bcast(&sum, 1, MPI_DOUBLE, 0, comm);
+    free(isum);
+    free(local_isum);
+
     return sum;
 }
+
+/* Binned numbers are added exactly, so the result does not depend on the reduction order of
+ * MPI_Iallreduce and every rank converts the same binned sum */
+class ReproBLASAccumulationRequest : public AccumulationRequest {
+public:
+    ReproBLASAccumulationRequest()
+        : request(MPI_REQUEST_NULL),
+          local_isum(binned_dballoc(3)),
+          isum(binned_dballoc(3)),
+          completed(false) {
+        binned_dbsetzero(3, local_isum);
+        binned_dbsetzero(3, isum);
+    }
+
+    virtual ~ReproBLASAccumulationRequest() {
+        free(local_isum);
+        free(isum);
+    }
+
+    virtual bool test() {
+        if (!completed) {
+            int flag;
+            MPI_Test(&request, &flag, MPI_STATUS_IGNORE);
+            completed = flag;
+        }
+        return completed;
+    }
+
+    virtual double wait() {
+        if (!completed) {
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+            completed = true;
+        }
+        return binned_ddbconv(3, isum);
+    }
+
+    MPI_Request request;
+    double_binned *local_isum;
+    double_binned *isum;
+    bool completed;
+};
+
+std::unique_ptr<AccumulationRequest> ReproBLASSummation::iaccumulate() {
+    auto request = std::make_unique<ReproBLASAccumulationRequest>();
+
+    // Local summation
+    binnedBLAS_dbdsum(3, n_summands[rank], &summands[0], 1, request->local_isum);
+
+    MPI_Iallreduce(request->local_isum, request->isum, 1, binnedMPI_DOUBLE_BINNED(3),
+            binnedMPI_DBDBADD(3), comm, &request->request);
+
+    return request;
+}
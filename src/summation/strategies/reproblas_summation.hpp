@@ -7,6 +7,8 @@ class ReproBLASSummation : public SummationStrategy {
 public:
     using SummationStrategy::SummationStrategy;
     double accumulate();
+    double accumulate_to(const int root);
+    std::unique_ptr<AccumulationRequest> iaccumulate();
 
 };
 
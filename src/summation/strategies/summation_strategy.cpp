@@ -8,6 +8,39 @@
 #include <numeric>
 #include <limits>
 
+AccumulationRequest::~AccumulationRequest() {
+
+}
+
+CompletedAccumulationRequest::CompletedAccumulationRequest(const double result)
+    : result(result) {
+}
+
+bool CompletedAccumulationRequest::test() {
+    return true;
+}
+
+double CompletedAccumulationRequest::wait() {
+    return result;
+}
+
+MPIAccumulationRequest::MPIAccumulationRequest()
+    : request(MPI_REQUEST_NULL),
+      localSum(0.0),
+      result(0.0) {
+}
+
+bool MPIAccumulationRequest::test() {
+    int flag;
+    MPI_Test(&request, &flag, MPI_STATUS_IGNORE);
+    return flag;
+}
+
+double MPIAccumulationRequest::wait() {
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+    return result;
+}
+
 SummationStrategy::SummationStrategy(uint64_t rank, vector<int> &n_summands, MPI_Comm comm)
     : n_summands(n_summands),
       rank(rank),
@@ -53,6 +86,14 @@ void SummationStrategy::distribute(vector<double> &values) {
     }
 }
 
+double SummationStrategy::accumulate_to(const int root) {
+    return accumulate();
+}
+
+std::unique_ptr<AccumulationRequest> SummationStrategy::iaccumulate() {
+    return std::make_unique<CompletedAccumulationRequest>(accumulate());
+}
+
 const vector<double>& SummationStrategy::getSummands() {
     return summands;
 }
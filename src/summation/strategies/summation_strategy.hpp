@@ -2,12 +2,57 @@
 #define SUMMATION_STRATEGY_HPP_
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 #include <utility>
 #include <mpi.h>
 
 using std::vector;
 
+/**
+ * Handle of a reduction that has been started with SummationStrategy::iaccumulate. The strategy
+ * must outlive the handle and no other reduction may be started until it has completed.
+ */
+class AccumulationRequest {
+public:
+    virtual ~AccumulationRequest();
+
+    /**
+     * Make progress on the reduction without blocking
+     * @return true once the result is available
+     */
+    virtual bool test() = 0;
+
+    /**
+     * Block until the reduction has completed
+     * @return The global sum
+     */
+    virtual double wait() = 0;
+};
+
+/* Request of a reduction that was already completed when it has been started */
+class CompletedAccumulationRequest : public AccumulationRequest {
+public:
+    CompletedAccumulationRequest(const double result);
+    virtual bool test();
+    virtual double wait();
+
+protected:
+    const double result;
+};
+
+/* Request of a single nonblocking MPI operation that leaves its result in the member result */
+class MPIAccumulationRequest : public AccumulationRequest {
+public:
+    MPIAccumulationRequest();
+    virtual bool test();
+    virtual double wait();
+
+    MPI_Request request;
+    double localSum;
+    double result;
+};
+
 class SummationStrategy {
 public:
     /**
@@ -31,6 +76,20 @@ public:
 
     virtual double accumulate() = 0;
 
+    /**
+     * Sum all numbers without distributing the result to every rank. Strategies that have no
+     * dedicated implementation fall back to accumulate.
+     * @param root The rank that receives the result
+     * @return The global sum on root, unspecified on the other ranks
+     */
+    virtual double accumulate_to(const int root);
+
+    /**
+     * Start the reduction without waiting for it to complete, so other work can be overlapped with
+     * the communication. Strategies without a nonblocking implementation block in this call.
+     */
+    virtual std::unique_ptr<AccumulationRequest> iaccumulate();
+
     virtual ~SummationStrategy();
 
     virtual const void printStats(void) const {
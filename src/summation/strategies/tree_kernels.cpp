@@ -0,0 +1,185 @@
+#include "tree_kernels.hpp"
+
+#include <immintrin.h>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+/* The kernels are compiled for their instruction set only, the rest of the program does not require
+ * any extension. They must not be called before checking TreeKernels::supported. */
+
+static void accumulate_8subtrees_scalar(const double *src, double *dst, const uint64_t count) {
+    for (uint64_t i = 0; i < count; i++) {
+        const double *leaves = &src[8 * i];
+
+        const double level1a = leaves[0] + leaves[1];
+        const double level1b = leaves[2] + leaves[3];
+        const double level1c = leaves[4] + leaves[5];
+        const double level1d = leaves[6] + leaves[7];
+
+        const double level2a = level1a + level1b;
+        const double level2b = level1c + level1d;
+
+        dst[i] = level2a + level2b;
+    }
+}
+
+/* The vector kernels reduce several neighbouring subtrees at once. Unpacking and permuting lanes
+ * transposes the partial sums of different subtrees into the same vector, so that every level is a
+ * single vertical add instead of a horizontal add per subtree. The remaining subtrees are reduced
+ * with the scalar kernel, which performs the same additions. */
+
+__attribute__((target("avx2")))
+static void accumulate_8subtrees_avx2(const double *src, double *dst, const uint64_t count) {
+    uint64_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        const double *leaves = &src[8 * i];
+
+        // Level 1: pairs of neighbouring leaves, two subtrees per vector
+        //   a = [s0(0+1), s1(0+1), s0(2+3), s1(2+3)], b = [s0(4+5), s1(4+5), s0(6+7), s1(6+7)]
+        __m256d x0 = _mm256_loadu_pd(&leaves[0]);
+        __m256d x1 = _mm256_loadu_pd(&leaves[8]);
+        __m256d a01 = _mm256_add_pd(_mm256_unpacklo_pd(x0, x1), _mm256_unpackhi_pd(x0, x1));
+        x0 = _mm256_loadu_pd(&leaves[4]);
+        x1 = _mm256_loadu_pd(&leaves[12]);
+        __m256d b01 = _mm256_add_pd(_mm256_unpacklo_pd(x0, x1), _mm256_unpackhi_pd(x0, x1));
+
+        x0 = _mm256_loadu_pd(&leaves[16]);
+        x1 = _mm256_loadu_pd(&leaves[24]);
+        __m256d a23 = _mm256_add_pd(_mm256_unpacklo_pd(x0, x1), _mm256_unpackhi_pd(x0, x1));
+        x0 = _mm256_loadu_pd(&leaves[20]);
+        x1 = _mm256_loadu_pd(&leaves[28]);
+        __m256d b23 = _mm256_add_pd(_mm256_unpacklo_pd(x0, x1), _mm256_unpackhi_pd(x0, x1));
+
+        // Level 2: [s0(0..3), s1(0..3), s0(4..7), s1(4..7)]
+        __m256d c01 = _mm256_add_pd(_mm256_permute2f128_pd(a01, b01, 0x20),
+                _mm256_permute2f128_pd(a01, b01, 0x31));
+        __m256d c23 = _mm256_add_pd(_mm256_permute2f128_pd(a23, b23, 0x20),
+                _mm256_permute2f128_pd(a23, b23, 0x31));
+
+        // Level 3: [s0, s1, s2, s3]
+        __m256d sums = _mm256_add_pd(_mm256_permute2f128_pd(c01, c23, 0x20),
+                _mm256_permute2f128_pd(c01, c23, 0x31));
+
+        _mm256_storeu_pd(&dst[i], sums);
+    }
+
+    accumulate_8subtrees_scalar(&src[8 * i], &dst[i], count - i);
+}
+
+/* GCC 12 reports the placeholder of _mm512_undefined_pd, which the unpack and shuffle intrinsics pass
+ * as their unused merge source, as uninitialized (GCC bug 105593). All vectors here are loaded. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f")))
+static void accumulate_8subtrees_avx512(const double *src, double *dst, const uint64_t count) {
+    uint64_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        const double *leaves = &src[8 * i];
+        __m512d level1[4];
+
+        // Level 1: pairs of neighbouring leaves of two subtrees interleaved,
+        //   [s0(0+1), s1(0+1), s0(2+3), s1(2+3), s0(4+5), s1(4+5), s0(6+7), s1(6+7)]
+        for (int j = 0; j < 4; j++) {
+            __m512d x0 = _mm512_loadu_pd(&leaves[16 * j]);
+            __m512d x1 = _mm512_loadu_pd(&leaves[16 * j + 8]);
+            level1[j] = _mm512_add_pd(_mm512_unpacklo_pd(x0, x1), _mm512_unpackhi_pd(x0, x1));
+        }
+
+        // Level 2: [s0(0..3), s1(0..3), s0(4..7), s1(4..7), s2(0..3), s3(0..3), s2(4..7), s3(4..7)]
+        __m512d c0 = _mm512_add_pd(_mm512_shuffle_f64x2(level1[0], level1[1], 0x88),
+                _mm512_shuffle_f64x2(level1[0], level1[1], 0xdd));
+        __m512d c1 = _mm512_add_pd(_mm512_shuffle_f64x2(level1[2], level1[3], 0x88),
+                _mm512_shuffle_f64x2(level1[2], level1[3], 0xdd));
+
+        // Level 3: [s0, s1, ..., s7]
+        __m512d sums = _mm512_add_pd(_mm512_shuffle_f64x2(c0, c1, 0x88),
+                _mm512_shuffle_f64x2(c0, c1, 0xdd));
+
+        _mm512_storeu_pd(&dst[i], sums);
+    }
+
+    accumulate_8subtrees_scalar(&src[8 * i], &dst[i], count - i);
+}
+#pragma GCC diagnostic pop
+
+/* Rows of the first row pair overlap with the destination row, so both are loaded before storing */
+static void reduce_rows_scalar(const double *src, double *dst, const uint64_t rows, const uint64_t columns) {
+    for (uint64_t i = 0; i < rows; i++) {
+        const double *a = &src[2 * i * columns];
+        const double *b = a + columns;
+
+        for (uint64_t k = 0; k < columns; k++) {
+            dst[i * columns + k] = a[k] + b[k];
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void reduce_rows_avx2(const double *src, double *dst, const uint64_t rows, const uint64_t columns) {
+    for (uint64_t i = 0; i < rows; i++) {
+        const double *a = &src[2 * i * columns];
+        const double *b = a + columns;
+        double *row = &dst[i * columns];
+        uint64_t k = 0;
+
+        for (; k + 4 <= columns; k += 4) {
+            _mm256_storeu_pd(&row[k], _mm256_add_pd(_mm256_loadu_pd(&a[k]), _mm256_loadu_pd(&b[k])));
+        }
+        for (; k < columns; k++) {
+            row[k] = a[k] + b[k];
+        }
+    }
+}
+
+static const AccumulationKernel kernels[] = {
+    { KernelVariant::SCALAR, "scalar", 3, accumulate_8subtrees_scalar },
+    { KernelVariant::AVX2, "avx2", 3, accumulate_8subtrees_avx2 },
+    { KernelVariant::AVX512, "avx512", 3, accumulate_8subtrees_avx512 },
+};
+
+const bool TreeKernels::supported(const KernelVariant variant) {
+    switch (variant) {
+        case KernelVariant::SCALAR:
+            return true;
+        case KernelVariant::AVX2:
+            return __builtin_cpu_supports("avx2");
+        case KernelVariant::AVX512:
+            return __builtin_cpu_supports("avx512f");
+    }
+
+    return false;
+}
+
+const AccumulationKernel& TreeKernels::get(const KernelVariant variant) {
+    const AccumulationKernel &kernel = kernels[static_cast<int>(variant)];
+
+    if (!supported(variant)) {
+        throw runtime_error("Accumulation kernel "s + kernel.name + " is not supported by this CPU");
+    }
+
+    return kernel;
+}
+
+const AccumulationKernel& TreeKernels::best(void) {
+    static const AccumulationKernel &kernel = supported(KernelVariant::AVX512) ? kernels[2]
+        : supported(KernelVariant::AVX2) ? kernels[1] : kernels[0];
+
+    return kernel;
+}
+
+void TreeKernels::accumulate_8subtrees(const double *src, double *dst, const uint64_t count) {
+    static const auto reduce = supported(KernelVariant::AVX2) ? accumulate_8subtrees_avx2
+        : accumulate_8subtrees_scalar;
+
+    reduce(src, dst, count);
+}
+
+void TreeKernels::reduce_rows(const double *src, double *dst, const uint64_t rows, const uint64_t columns) {
+    static const auto reduce = supported(KernelVariant::AVX2) ? reduce_rows_avx2 : reduce_rows_scalar;
+
+    reduce(src, dst, rows, columns);
+}
@@ -0,0 +1,43 @@
+#ifndef TREE_KERNELS_HPP_
+#define TREE_KERNELS_HPP_
+
+#include <cstdint>
+
+enum class KernelVariant {
+    SCALAR,
+    AVX2,
+    AVX512
+};
+
+/** Reduces consecutive complete subtrees with 2^levels leaves each. Every variant adds the leaves in
+ * tree order, so all of them produce the same bits. */
+struct AccumulationKernel {
+    KernelVariant variant;
+    const char *name;
+    int levels;
+
+    /** Sum count subtrees from src into dst. Source and destination may overlap as long as
+     * dst <= src */
+    void (*reduce)(const double *src, double *dst, const uint64_t count);
+};
+
+namespace TreeKernels {
+    /** Check via CPUID whether the machine we are running on can execute a variant */
+    const bool supported(const KernelVariant variant);
+
+    /** Look up a variant, throws if the CPU does not support it */
+    const AccumulationKernel& get(const KernelVariant variant);
+
+    /** Fastest supported variant, selected once at startup */
+    const AccumulationKernel& best(void);
+
+    /** Reduce subtrees with 8 leaves using the fastest supported instructions */
+    void accumulate_8subtrees(const double *src, double *dst, const uint64_t count);
+
+    /** Add neighbouring rows of a row-major matrix, row i of dst is the sum of rows 2i and 2i + 1 of src.
+     * Every column is added separately, so each of them is reduced exactly like a single series.
+     * Source and destination may overlap as long as dst <= src */
+    void reduce_rows(const double *src, double *dst, const uint64_t rows, const uint64_t columns);
+}
+
+#endif
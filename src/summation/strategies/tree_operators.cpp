@@ -0,0 +1,237 @@
+#include "tree_operators.hpp"
+#include "tree_kernels.hpp"
+
+#include <bit>
+#include <cmath>
+#include <immintrin.h>
+
+/* Like the accumulation kernels, the vector variants are compiled for AVX2 only and selected at
+ * runtime. They must not be compiled with FMA, since a fused multiply-add rounds differently than the
+ * separate operations of the scalar code. */
+
+template <typename Operator>
+static void reduce_pairs_scalar(const double *src, double *dst, const uint64_t count) {
+    for (uint64_t i = 0; i < count; i++) {
+        dst[i] = Operator::combine(src[2 * i], src[2 * i + 1]);
+    }
+}
+
+struct AddInstruction {
+    __attribute__((target("avx2")))
+    static __m256d apply(const __m256d a, const __m256d b) { return _mm256_add_pd(a, b); }
+};
+
+struct MulInstruction {
+    __attribute__((target("avx2")))
+    static __m256d apply(const __m256d a, const __m256d b) { return _mm256_mul_pd(a, b); }
+};
+
+struct MinInstruction {
+    __attribute__((target("avx2")))
+    static __m256d apply(const __m256d a, const __m256d b) { return _mm256_min_pd(a, b); }
+};
+
+struct MaxInstruction {
+    __attribute__((target("avx2")))
+    static __m256d apply(const __m256d a, const __m256d b) { return _mm256_max_pd(a, b); }
+};
+
+/* Neighbouring values are separated into the left and right operands of four pairs, which leaves the
+ * results in the order 0, 2, 1, 3 */
+template <typename Operator, typename Instruction>
+__attribute__((target("avx2")))
+static void reduce_pairs_avx2(const double *src, double *dst, const uint64_t count) {
+    uint64_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        const __m256d x0 = _mm256_loadu_pd(&src[2 * i]);
+        const __m256d x1 = _mm256_loadu_pd(&src[2 * i + 4]);
+
+        const __m256d result = Instruction::apply(_mm256_unpacklo_pd(x0, x1), _mm256_unpackhi_pd(x0, x1));
+        _mm256_storeu_pd(&dst[i], _mm256_permute4x64_pd(result, 0xD8));
+    }
+
+    reduce_pairs_scalar<Operator>(&src[2 * i], &dst[i], count - i);
+}
+
+template <typename Operator, typename Instruction>
+static void reduce_pairs(const double *src, double *dst, const uint64_t count) {
+    static const auto reduce = TreeKernels::supported(KernelVariant::AVX2)
+        ? reduce_pairs_avx2<Operator, Instruction> : reduce_pairs_scalar<Operator>;
+
+    reduce(src, dst, count);
+}
+
+void SumOperator::reduce_pairs(const double *src, double *dst, const uint64_t count) {
+    ::reduce_pairs<SumOperator, AddInstruction>(src, dst, count);
+}
+
+void ProductOperator::reduce_pairs(const double *src, double *dst, const uint64_t count) {
+    ::reduce_pairs<ProductOperator, MulInstruction>(src, dst, count);
+}
+
+void MinOperator::reduce_pairs(const double *src, double *dst, const uint64_t count) {
+    ::reduce_pairs<MinOperator, MinInstruction>(src, dst, count);
+}
+
+void MaxOperator::reduce_pairs(const double *src, double *dst, const uint64_t count) {
+    ::reduce_pairs<MaxOperator, MaxInstruction>(src, dst, count);
+}
+
+/* exp(x) = 2^n * exp(r) with r = x - n * ln(2) in [-ln(2) / 2, ln(2) / 2]. ln(2) is split into two
+ * parts, the first of which has enough trailing zeros that n * LN2_HIGH is exact. exp(r) is the
+ * Taylor polynomial of degree 13, whose truncation error is far below one ulp. */
+static const double EXP_UNDERFLOW = -708.0;
+static const double LOG2_E = 1.44269504088896338700e+00;
+static const double LN2_HIGH = 6.93147180369123816490e-01;
+static const double LN2_LOW = 1.90821492927058770002e-10;
+static const int EXP_DEGREE = 13;
+static const double EXP_COEFFICIENTS[EXP_DEGREE + 1] = {
+    1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 1.0 / 40320, 1.0 / 362880,
+    1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600, 1.0 / 6227020800
+};
+
+double LogSumExpOperator::exp(const double x) {
+    if (std::isnan(x)) {
+        return x;
+    } else if (!(x >= EXP_UNDERFLOW)) {
+        return 0.0;
+    }
+
+    const double n = std::nearbyint(x * LOG2_E);
+    const double r = (x - n * LN2_HIGH) - n * LN2_LOW;
+
+    double p = EXP_COEFFICIENTS[EXP_DEGREE];
+    for (int k = EXP_DEGREE - 1; k >= 0; k--) {
+        p = p * r + EXP_COEFFICIENTS[k];
+    }
+
+    const double scale = std::bit_cast<double>(static_cast<int64_t>(n + 1023) << 52);
+    return p * scale;
+}
+
+__attribute__((target("avx2")))
+static __m256d exp_avx2(const __m256d x) {
+    const __m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(LOG2_E)),
+            _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    const __m256d r = _mm256_sub_pd(_mm256_sub_pd(x, _mm256_mul_pd(n, _mm256_set1_pd(LN2_HIGH))),
+            _mm256_mul_pd(n, _mm256_set1_pd(LN2_LOW)));
+
+    __m256d p = _mm256_set1_pd(EXP_COEFFICIENTS[EXP_DEGREE]);
+    for (int k = EXP_DEGREE - 1; k >= 0; k--) {
+        p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(EXP_COEFFICIENTS[k]));
+    }
+
+    // Lanes outside of the range are replaced below, whatever their exponent turns into
+    const __m256i exponent = _mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n)),
+            _mm256_set1_epi64x(1023));
+    const __m256d scale = _mm256_castsi256_pd(_mm256_slli_epi64(exponent, 52));
+    const __m256d result = _mm256_mul_pd(p, scale);
+
+    const __m256d inRange = _mm256_cmp_pd(x, _mm256_set1_pd(EXP_UNDERFLOW), _CMP_GE_OQ);
+    const __m256d isNaN = _mm256_cmp_pd(x, x, _CMP_UNORD_Q);
+    const __m256d outOfRange = _mm256_blendv_pd(_mm256_setzero_pd(), x, isNaN);
+    return _mm256_blendv_pd(outOfRange, result, inRange);
+}
+
+/* Same branches as LogSumExpOperator::combine for four pairs at once */
+__attribute__((target("avx2")))
+static void combine_logsumexp_avx2(const __m256d aMax, const __m256d aSum, const __m256d bMax,
+        const __m256d bSum, __m256d &max, __m256d &sum) {
+    const __m256d equal = _mm256_cmp_pd(aMax, bMax, _CMP_EQ_OQ);
+    const __m256d greater = _mm256_cmp_pd(aMax, bMax, _CMP_GT_OQ);
+
+    const __m256d difference = _mm256_blendv_pd(_mm256_sub_pd(aMax, bMax), _mm256_sub_pd(bMax, aMax), greater);
+    const __m256d e = exp_avx2(difference);
+
+    const __m256d sumGreater = _mm256_add_pd(aSum, _mm256_mul_pd(bSum, e));
+    const __m256d sumLess = _mm256_add_pd(_mm256_mul_pd(aSum, e), bSum);
+    const __m256d sumEqual = _mm256_add_pd(aSum, bSum);
+
+    max = _mm256_blendv_pd(bMax, aMax, _mm256_or_pd(equal, greater));
+    sum = _mm256_blendv_pd(_mm256_blendv_pd(sumLess, sumGreater, greater), sumEqual, equal);
+}
+
+/* Results of the pairs 0, 2, 1, 3 are interleaved back into values */
+__attribute__((target("avx2")))
+static void store_logsumexp_avx2(LogSumExpValue *dst, const __m256d max, const __m256d sum) {
+    double *values = reinterpret_cast<double *>(dst);
+    _mm256_storeu_pd(&values[0], _mm256_unpacklo_pd(max, sum));
+    _mm256_storeu_pd(&values[4], _mm256_unpackhi_pd(max, sum));
+}
+
+static void reduce_leaves_logsumexp_scalar(const double *src, LogSumExpValue *dst, const uint64_t count) {
+    for (uint64_t i = 0; i < count; i++) {
+        dst[i] = LogSumExpOperator::combine(LogSumExpOperator::leaf(src[2 * i]),
+                LogSumExpOperator::leaf(src[2 * i + 1]));
+    }
+}
+
+__attribute__((target("avx2")))
+static void reduce_leaves_logsumexp_avx2(const double *src, LogSumExpValue *dst, const uint64_t count) {
+    uint64_t i = 0;
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    for (; i + 4 <= count; i += 4) {
+        const __m256d x0 = _mm256_loadu_pd(&src[2 * i]);
+        const __m256d x1 = _mm256_loadu_pd(&src[2 * i + 4]);
+
+        __m256d max, sum;
+        combine_logsumexp_avx2(_mm256_unpacklo_pd(x0, x1), one, _mm256_unpackhi_pd(x0, x1), one, max, sum);
+        store_logsumexp_avx2(&dst[i], max, sum);
+    }
+
+    reduce_leaves_logsumexp_scalar(&src[2 * i], &dst[i], count - i);
+}
+
+static void reduce_pairs_logsumexp_scalar(const LogSumExpValue *src, LogSumExpValue *dst,
+        const uint64_t count) {
+    for (uint64_t i = 0; i < count; i++) {
+        dst[i] = LogSumExpOperator::combine(src[2 * i], src[2 * i + 1]);
+    }
+}
+
+__attribute__((target("avx2")))
+static void reduce_pairs_logsumexp_avx2(const LogSumExpValue *src, LogSumExpValue *dst,
+        const uint64_t count) {
+    uint64_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        const double *values = reinterpret_cast<const double *>(&src[2 * i]);
+
+        // Left operands of the pairs 0 and 1, and 2 and 3, then the right operands
+        const __m256d v0 = _mm256_loadu_pd(&values[0]);
+        const __m256d v1 = _mm256_loadu_pd(&values[4]);
+        const __m256d v2 = _mm256_loadu_pd(&values[8]);
+        const __m256d v3 = _mm256_loadu_pd(&values[12]);
+        const __m256d a01 = _mm256_permute2f128_pd(v0, v1, 0x20);
+        const __m256d a23 = _mm256_permute2f128_pd(v2, v3, 0x20);
+        const __m256d b01 = _mm256_permute2f128_pd(v0, v1, 0x31);
+        const __m256d b23 = _mm256_permute2f128_pd(v2, v3, 0x31);
+
+        __m256d max, sum;
+        combine_logsumexp_avx2(_mm256_unpacklo_pd(a01, a23), _mm256_unpackhi_pd(a01, a23),
+                _mm256_unpacklo_pd(b01, b23), _mm256_unpackhi_pd(b01, b23), max, sum);
+        store_logsumexp_avx2(&dst[i], max, sum);
+    }
+
+    reduce_pairs_logsumexp_scalar(&src[2 * i], &dst[i], count - i);
+}
+
+double LogSumExpOperator::result(const LogSumExpValue v) {
+    return v.max + std::log(v.sum);
+}
+
+void LogSumExpOperator::reduce_leaves(const double *src, LogSumExpValue *dst, const uint64_t count) {
+    static const auto reduce = TreeKernels::supported(KernelVariant::AVX2)
+        ? reduce_leaves_logsumexp_avx2 : reduce_leaves_logsumexp_scalar;
+
+    reduce(src, dst, count);
+}
+
+void LogSumExpOperator::reduce_pairs(const LogSumExpValue *src, LogSumExpValue *dst, const uint64_t count) {
+    static const auto reduce = TreeKernels::supported(KernelVariant::AVX2)
+        ? reduce_pairs_logsumexp_avx2 : reduce_pairs_logsumexp_scalar;
+
+    reduce(src, dst, count);
+}
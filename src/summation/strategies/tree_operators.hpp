@@ -0,0 +1,111 @@
+#ifndef TREE_OPERATORS_HPP_
+#define TREE_OPERATORS_HPP_
+
+#include <cstdint>
+
+/* Associative operators for TreeReduction. Every summand becomes a value with leaf, two neighbouring
+ * values are merged by combine, left operand first, and the value of the root is turned into the
+ * result. Floating-point operators are not exactly associative, but the tree fixes the order of all
+ * operations, so the result does not depend on the number of ranks.
+ *
+ * reduce_leaves combines the leaves of the summands 2i and 2i + 1 into dst[i], reduce_pairs does the
+ * same for values. Source and destination may overlap as long as dst <= src. Their vector variants
+ * perform exactly the operations of combine, so all of them produce the same bits. Only a NaN may
+ * differ in sign and payload, since the compiler is free to swap the operands of + and *. */
+
+struct SumOperator {
+    using value_type = double;
+    static constexpr const char *name = "sum";
+
+    static value_type leaf(const double x) { return x; }
+    static value_type combine(const value_type a, const value_type b) { return a + b; }
+    static double result(const value_type v) { return v; }
+
+    static void reduce_leaves(const double *src, value_type *dst, const uint64_t count) {
+        reduce_pairs(src, dst, count);
+    }
+    static void reduce_pairs(const value_type *src, value_type *dst, const uint64_t count);
+};
+
+struct ProductOperator {
+    using value_type = double;
+    static constexpr const char *name = "product";
+
+    static value_type leaf(const double x) { return x; }
+    static value_type combine(const value_type a, const value_type b) { return a * b; }
+    static double result(const value_type v) { return v; }
+
+    static void reduce_leaves(const double *src, value_type *dst, const uint64_t count) {
+        reduce_pairs(src, dst, count);
+    }
+    static void reduce_pairs(const value_type *src, value_type *dst, const uint64_t count);
+};
+
+/* Comparisons are written like the minpd and maxpd instructions, so NaN and signed zeros are treated
+ * the same by all variants */
+struct MinOperator {
+    using value_type = double;
+    static constexpr const char *name = "min";
+
+    static value_type leaf(const double x) { return x; }
+    static value_type combine(const value_type a, const value_type b) { return (a < b) ? a : b; }
+    static double result(const value_type v) { return v; }
+
+    static void reduce_leaves(const double *src, value_type *dst, const uint64_t count) {
+        reduce_pairs(src, dst, count);
+    }
+    static void reduce_pairs(const value_type *src, value_type *dst, const uint64_t count);
+};
+
+struct MaxOperator {
+    using value_type = double;
+    static constexpr const char *name = "max";
+
+    static value_type leaf(const double x) { return x; }
+    static value_type combine(const value_type a, const value_type b) { return (a > b) ? a : b; }
+    static double result(const value_type v) { return v; }
+
+    static void reduce_leaves(const double *src, value_type *dst, const uint64_t count) {
+        reduce_pairs(src, dst, count);
+    }
+    static void reduce_pairs(const value_type *src, value_type *dst, const uint64_t count);
+};
+
+/* exp(max) * sum, which represents the sum of the exponentials of all leaves below a node */
+struct LogSumExpValue {
+    double max;
+    double sum;
+};
+
+/* log(sum(exp(x))) of log-space values such as log-likelihoods. Exponentials are only taken of
+ * differences to the larger maximum, so nothing overflows and small values do not vanish as long as
+ * they matter relative to the largest one. */
+struct LogSumExpOperator {
+    using value_type = LogSumExpValue;
+    static constexpr const char *name = "logsumexp";
+
+    static value_type leaf(const double x) { return { x, 1.0 }; }
+
+    static value_type combine(const value_type a, const value_type b) {
+        if (a.max == b.max) {
+            // Also covers two infinite maxima, whose difference would be NaN
+            return { a.max, a.sum + b.sum };
+        } else if (a.max > b.max) {
+            return { a.max, a.sum + b.sum * exp(b.max - a.max) };
+        } else {
+            return { b.max, a.sum * exp(a.max - b.max) + b.sum };
+        }
+    }
+
+    static double result(const value_type v);
+
+    static void reduce_leaves(const double *src, value_type *dst, const uint64_t count);
+    static void reduce_pairs(const value_type *src, value_type *dst, const uint64_t count);
+
+    /** Exponential of x <= 0. The vector variant performs the same operations, unlike the exp of the
+     * C library, which is why all variants give the same bits. Values below e^-708 are flushed to
+     * zero, they are smaller than the rounding error of any sum they are added to */
+    static double exp(const double x);
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "tree_sum.h"
 #include "strategies/binary_tree.hpp"
+#include "strategies/multi_column_tree.hpp"
 
 
 extern "C" {
@@ -8,4 +9,8 @@ double tree_sum(double *sendBuffer, size_t sendBufferLength, MPI_Comm comm) {
     return BinaryTreeSummation::global_sum(sendBuffer, sendBufferLength, comm);
 }
 
+void tree_allreduce(const double *sendBuffer, double *recvBuffer, int count, MPI_Comm comm) {
+    MultiColumnTreeSummation::allreduce(sendBuffer, 1, count, recvBuffer, comm);
+}
+
 }
@@ -12,4 +12,7 @@
 
 EXTERN double tree_sum(double *sendBuffer, size_t sendBufferLength, MPI_Comm comm);
 
+/* Reproducible element-wise sum of one vector per rank, like MPI_Allreduce with MPI_SUM */
+EXTERN void tree_allreduce(const double *sendBuffer, double *recvBuffer, int count, MPI_Comm comm);
+
 #endif
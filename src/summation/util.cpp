@@ -53,6 +53,19 @@ void __attribute__((optimize("O0"))) Util::attach_debugger(bool condition) {
     while (!attached) sleep(1);
 }
 
+MPI_Comm Util::duplicate(MPI_Comm comm) {
+    int initialized;
+    MPI_Initialized(&initialized);
+    if (!initialized) {
+        // MPI-less variant for testing
+        return comm;
+    }
+
+    MPI_Comm duplicate;
+    MPI_Comm_dup(comm, &duplicate);
+    return duplicate;
+}
+
 const bool Util::is_power2(const unsigned long int x) {
     /* If x is a power of 2, there is exactly one bit set. We determine the
      * index of the lowest bit set with ffsl. We then produce a number where
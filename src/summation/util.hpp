@@ -8,6 +8,7 @@
 #include <limits>
 #include <new>
 #include <vector>
+#include <mpi.h>
 
 using std::vector;
 
@@ -20,6 +21,10 @@ namespace Util {
     const bool is_power2(const unsigned long int x);
     void attach_debugger(bool condition);
 
+    /** Communicator of our own, so point-to-point messages are kept apart from those of other
+     * reductions on the same ranks. Returns comm itself if MPI has not been initialized */
+    MPI_Comm duplicate(MPI_Comm comm);
+
     /** Zip through two iterators and call a function */
     template<class Iter1, class Iter2, typename F>
         void zip(
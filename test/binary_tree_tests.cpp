@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <random>
+#include <thread>
 #include <gtest/gtest.h>
 #include <vector>
 #include <cmath>
+#include <cstring>
 #include <distribution.hpp>
 #include "strategies/binary_tree.hpp"
 
@@ -107,3 +110,561 @@ TEST(BinaryTreeTests, rankFromIndexClosedForm) {
         }
     }
 }
+
+TEST(BinaryTreeTests, ReductionPlanStructure) {
+    vector<int> n_summands { 3, 2, 4 };
+
+    // Rank 0 computes the root from local summands 0, 1, 2 and the remote subtrees 3, 4 and 8
+    ReductionPlan rk0(0, n_summands);
+    ASSERT_EQ(rk0.subtrees.size(), 1);
+    EXPECT_EQ(rk0.subtrees[0].index, 0);
+    EXPECT_EQ(rk0.subtrees[0].lastLocalIndex, 2);
+    EXPECT_EQ(rk0.subtrees[0].targetRank, -1);
+
+    ASSERT_EQ(rk0.operations.size(), 4);
+    EXPECT_EQ(rk0.operations[0].type, PlanOperation::REMOTE_VALUE);
+    EXPECT_EQ(rk0.operations[0].index, 3);
+    EXPECT_EQ(rk0.operations[0].rank, 1);
+    EXPECT_EQ(rk0.operations[1].type, PlanOperation::LOCAL_BLOCK);
+    EXPECT_EQ(rk0.operations[1].index, 0);
+    EXPECT_EQ(rk0.operations[1].level, 1);
+    EXPECT_EQ(rk0.operations[2].index, 4);
+    EXPECT_EQ(rk0.operations[2].rank, 1);
+    EXPECT_EQ(rk0.operations[3].index, 8);
+    EXPECT_EQ(rk0.operations[3].rank, 2);
+    EXPECT_EQ(rk0.remoteValueCount, 3);
+
+    // Rank 1 sends summand 3 as is and subtree 4, which needs summands 5 and 6..7 from rank 2
+    ReductionPlan rk1(1, n_summands);
+    ASSERT_EQ(rk1.subtrees.size(), 2);
+    EXPECT_EQ(rk1.subtrees[0].index, 3);
+    EXPECT_EQ(rk1.subtrees[0].operationCount, 0);
+    EXPECT_EQ(rk1.subtrees[0].targetRank, 0);
+    EXPECT_EQ(rk1.subtrees[1].index, 4);
+    EXPECT_EQ(rk1.subtrees[1].targetRank, 0);
+    ASSERT_EQ(rk1.subtrees[1].operationCount, 2);
+    EXPECT_EQ(rk1.operations[0].index, 5);
+    EXPECT_EQ(rk1.operations[1].index, 6);
+    EXPECT_EQ(rk1.operations[1].rank, 2);
+
+    // Rank 2 only has local work
+    ReductionPlan rk2(2, n_summands);
+    ASSERT_EQ(rk2.subtrees.size(), 3);
+    EXPECT_EQ(rk2.subtrees[0].targetRank, 1);
+    EXPECT_EQ(rk2.subtrees[1].targetRank, 1);
+    EXPECT_EQ(rk2.subtrees[2].targetRank, 0);
+    EXPECT_EQ(rk2.remoteValueCount, 0);
+}
+
+TEST(BinaryTreeTests, PlanReplayEqualToIterative) {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<> n_distrib(1, 100'000);
+    std::uniform_real_distribution<> value_distrib(-1e6, 1e6);
+
+    for (int i = 0; i < 10; i++) {
+        const int n = n_distrib(gen);
+        vector<int> n_summands { n };
+        vector<double> numbers(n);
+
+        for (int j = 0; j < n; j++) {
+            numbers[j] = value_distrib(gen);
+        }
+
+        BinaryTreeSummation tree(0, n_summands);
+        tree.distribute(numbers);
+
+        EXPECT_EQ(tree.replayPlan(), tree.accumulate(0)) << "n = " << n;
+    }
+}
+
+TEST(BinaryTreeTests, ReductionPlanMessages) {
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<> n_distrib(1, 5000);
+    std::uniform_int_distribution<> m_distrib(2, 64);
+
+    for (int i = 0; i < 20; i++) {
+        auto d = Distribution::even_remainder_on_last(n_distrib(gen), m_distrib(gen));
+        vector<int> nSummands;
+        for (auto x : d.nSummands) nSummands.push_back(x);
+
+        for (uint64_t rank = 0; rank < d.ranks; rank++) {
+            ReductionPlan plan(rank, nSummands);
+
+            // Every remote value arrives in exactly one incoming message
+            vector<uint64_t> remoteIndices;
+            for (const auto &op : plan.operations) {
+                if (op.type == PlanOperation::REMOTE_VALUE) remoteIndices.push_back(op.index);
+            }
+            vector<uint64_t> incomingIndices = plan.incomingIndices;
+            std::sort(remoteIndices.begin(), remoteIndices.end());
+            std::sort(incomingIndices.begin(), incomingIndices.end());
+            EXPECT_EQ(remoteIndices, incomingIndices) << "n = " << d.n << " m = " << d.ranks << " rank = " << rank;
+
+            uint32_t entries = 0;
+            for (const auto &m : plan.outgoingMessages) {
+                EXPECT_GT(m.count, 0);
+                EXPECT_TRUE(plan.subtrees[m.first].flushBefore);
+
+                // Only the first subtree of a message may wait for other ranks, the others must be
+                // completed before the receiver needs the message
+                for (uint32_t j = m.first + 1; j < m.first + m.count; j++) {
+                    const auto &subtree = plan.subtrees[j];
+                    const uint64_t subtreeEnd = std::min(subtree.index + (subtree.index & (~subtree.index + 1)), plan.end);
+                    EXPECT_FALSE(subtree.flushBefore);
+                    EXPECT_EQ(subtree.targetRank, m.peer);
+                    EXPECT_LE(subtreeEnd - plan.begin, nSummands[m.peer]);
+                }
+                entries += m.count;
+            }
+            EXPECT_EQ(entries, (rank == 0) ? 0 : plan.subtrees.size());
+        }
+    }
+}
+
+TEST(BinaryTreeTests, ReductionPlanCriticalPathSchedule) {
+    std::mt19937 gen(17);
+    std::uniform_int_distribution<> n_distrib(1, 50000);
+    std::uniform_int_distribution<> m_distrib(2, 48);
+
+    for (int i = 0; i < 20; i++) {
+        const uint64_t n = n_distrib(gen);
+        const int m = m_distrib(gen);
+        auto d = (i % 2 == 0) ? Distribution::even_remainder_on_last(n, m) : Distribution::lsb_cleared(n, m, 0.5);
+        vector<int> nSummands;
+        for (auto x : d.nSummands) nSummands.push_back(x);
+
+        const auto timings = ReductionPlan::simulate(nSummands, false, SendSchedule::LOCAL_WORK, false);
+
+        for (uint64_t rank = 0; rank < d.ranks; rank++) {
+            ReductionPlan plan(rank, nSummands, true, false, SendSchedule::CRITICAL_PATH);
+
+            vector<uint64_t> remoteIndices = plan.remoteIndices;
+            vector<uint64_t> incomingIndices = plan.incomingIndices;
+            std::sort(incomingIndices.begin(), incomingIndices.end());
+            EXPECT_EQ(remoteIndices, incomingIndices) << "n = " << d.n << " m = " << d.ranks << " rank = " << rank;
+
+            // Grouped subtrees arrive before the receiver needs the first one of the message
+            for (const auto &message : plan.outgoingMessages) {
+                const double needed = timings.at(plan.subtrees[message.first].index).needed;
+                for (uint32_t j = message.first + 1; j < message.first + message.count; j++) {
+                    EXPECT_LE(timings.at(plan.subtrees[j].index).completed + ReductionPlan::SEND_COST, needed);
+                }
+            }
+        }
+
+        // So grouping by the critical path never delays the root, unlike grouping by local work
+        const double ungrouped = timings.at(0).completed;
+        const double criticalPath = ReductionPlan::simulate(nSummands, false, SendSchedule::CRITICAL_PATH, true).at(0).completed;
+        const double localWork = ReductionPlan::simulate(nSummands, false, SendSchedule::LOCAL_WORK, true).at(0).completed;
+        EXPECT_EQ(criticalPath, ungrouped) << "n = " << d.n << " m = " << d.ranks;
+        EXPECT_GE(localWork, ungrouped) << "n = " << d.n << " m = " << d.ranks;
+    }
+}
+
+TEST(BinaryTreeTests, ReductionPlanPositions) {
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<> n_distrib(1, 5000);
+    std::uniform_int_distribution<> m_distrib(2, 64);
+
+    for (int i = 0; i < 20; i++) {
+        auto d = Distribution::even_remainder_on_last(n_distrib(gen), m_distrib(gen));
+        vector<int> nSummands;
+        for (auto x : d.nSummands) nSummands.push_back(x);
+
+        for (uint64_t rank = 0; rank < d.ranks; rank++) {
+            ReductionPlan plan(rank, nSummands);
+
+            // Every remote value has its own slot, which the incoming entries are unpacked into
+            for (const auto &op : plan.operations) {
+                if (op.type == PlanOperation::REMOTE_VALUE) {
+                    EXPECT_EQ(plan.remotePosition(op.index), op.position);
+                }
+            }
+            ASSERT_EQ(plan.incomingPositions.size(), plan.incomingIndices.size());
+            for (size_t j = 0; j < plan.incomingIndices.size(); j++) {
+                EXPECT_EQ(plan.remoteIndices[plan.incomingPositions[j]], plan.incomingIndices[j]);
+            }
+
+            // Messages between the same ranks are numbered consecutively
+            map<int, uint32_t> sequence;
+            for (const auto &m : plan.incomingMessages) {
+                EXPECT_EQ(m.sequence, sequence[m.peer]++);
+            }
+        }
+    }
+}
+
+TEST(BinaryTreeTests, ReductionPlanRounds) {
+    std::mt19937 gen(13);
+    std::uniform_int_distribution<> n_distrib(1, 50000);
+    std::uniform_int_distribution<> m_distrib(2, 1024);
+
+    for (int i = 0; i < 10; i++) {
+        auto d = Distribution::even_remainder_on_last(n_distrib(gen), m_distrib(gen));
+        vector<int> nSummands;
+        for (auto x : d.nSummands) nSummands.push_back(x);
+
+        vector<ReductionPlan> plans;
+        map<uint64_t, uint32_t> rounds;
+        for (uint64_t rank = 0; rank < d.ranks; rank++) {
+            plans.emplace_back(rank, nSummands);
+            for (const auto &subtree : plans.back().subtrees) rounds[subtree.index] = subtree.round;
+        }
+
+        // A subtree is computed in a later round than all values it depends on
+        for (const auto &plan : plans) {
+            for (size_t j = 0; j < plan.incomingIndices.size(); j++) {
+                EXPECT_EQ(plan.incomingRounds[j], rounds[plan.incomingIndices[j]]);
+            }
+
+            for (const auto &subtree : plan.subtrees) {
+                EXPECT_LT(subtree.round, plan.roundCount);
+                for (uint32_t k = subtree.firstOperation; k < subtree.firstOperation + subtree.operationCount; k++) {
+                    const auto &op = plan.operations[k];
+                    if (op.type == PlanOperation::REMOTE_VALUE) {
+                        EXPECT_GT(subtree.round, rounds[op.index]) << "n = " << d.n << " m = " << d.ranks;
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(BinaryTreeTests, ReductionPlanRootOnAllRanks) {
+    std::mt19937 gen(17);
+    std::uniform_int_distribution<> n_distrib(1, 5000);
+    std::uniform_int_distribution<> m_distrib(2, 64);
+
+    for (int i = 0; i < 20; i++) {
+        auto d = Distribution::even_remainder_on_last(n_distrib(gen), m_distrib(gen));
+        vector<int> nSummands;
+        for (auto x : d.nSummands) nSummands.push_back(x);
+
+        // The inputs of the root are computed by the other ranks but not sent anywhere
+        const int rootRank = ReductionPlan(0, nSummands, false).rankFromIndex(0);
+        const ReductionPlan root(rootRank, nSummands);
+        vector<uint64_t> rootInputs;
+        for (const auto &op : root.operations) {
+            if (op.type == PlanOperation::REMOTE_VALUE) rootInputs.push_back(op.index);
+        }
+
+        vector<uint64_t> topLevel;
+        for (uint64_t rank = 0; rank < d.ranks; rank++) {
+            ReductionPlan plan(rank, nSummands, true, true);
+
+            EXPECT_TRUE(plan.incomingMessages.size() == 0 || static_cast<int>(rank) != rootRank);
+            for (const auto &subtree : plan.subtrees) {
+                EXPECT_NE(subtree.targetRank, -1);
+                if (subtree.targetRank == PlanSubtree::TOP_LEVEL) topLevel.push_back(subtree.index);
+            }
+            for (const auto &m : plan.outgoingMessages) EXPECT_NE(m.peer, rootRank);
+        }
+        EXPECT_EQ(topLevel, rootInputs) << "n = " << d.n << " m = " << d.ranks;
+    }
+}
+
+TEST(BinaryTreeTests, ThreadsGiveIdenticalResults) {
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<> n_distrib(1 << 16, 1 << 20);
+    std::uniform_real_distribution<> value_distrib(-1e10, 1e10);
+
+    for (int i = 0; i < 5; i++) {
+        const int n = n_distrib(gen);
+        vector<int> n_summands { n };
+        vector<double> numbers(n);
+
+        for (int j = 0; j < n; j++) {
+            numbers[j] = value_distrib(gen);
+        }
+
+        BinaryTreeSummation tree(0, n_summands);
+        tree.distribute(numbers);
+        const double reference = tree.replayPlan();
+
+        for (int threads = 2; threads <= 8; threads++) {
+            tree.setThreads(threads);
+            EXPECT_EQ(tree.replayPlan(), reference) << "n = " << n << " threads = " << threads;
+        }
+    }
+}
+
+TEST(BinaryTreeTests, KernelVariantsGiveIdenticalResults) {
+    std::mt19937 gen(4);
+    std::uniform_int_distribution<> n_distrib(1, 100000);
+    std::uniform_real_distribution<> value_distrib(-1e10, 1e10);
+
+    for (int i = 0; i < 20; i++) {
+        const int n = n_distrib(gen);
+        vector<int> n_summands { n };
+        vector<double> numbers(n);
+
+        for (int j = 0; j < n; j++) {
+            numbers[j] = value_distrib(gen);
+        }
+
+        BinaryTreeSummation tree(0, n_summands);
+        tree.distribute(numbers);
+        tree.setKernel(KernelVariant::SCALAR);
+        const double reference = tree.replayPlan();
+
+        for (const auto variant : { KernelVariant::AVX2, KernelVariant::AVX512 }) {
+            if (!TreeKernels::supported(variant)) continue;
+
+            tree.setKernel(variant);
+            EXPECT_EQ(tree.replayPlan(), reference) << "n = " << n << " kernel = " << tree.getKernel().name;
+        }
+    }
+}
+
+TEST(BinaryTreeTests, ConcurrentInstances) {
+    // Tiny trees used to shrink the scratch memory that was shared by all instances
+    vector<int> n_tiny { 3 };
+    vector<double> tinyNumbers { 1.0, 2.0, 3.0 };
+    BinaryTreeSummation tiny(0, n_tiny);
+    tiny.distribute(tinyNumbers);
+
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<> value_distrib(-1e10, 1e10);
+
+    vector<vector<double>> numbers(4);
+    vector<double> expected;
+    for (size_t i = 0; i < numbers.size(); i++) {
+        numbers[i].resize(50'000 + 1'000 * i);
+        for (auto &x : numbers[i]) {
+            x = value_distrib(gen);
+        }
+
+        vector<int> n_summands { static_cast<int>(numbers[i].size()) };
+        BinaryTreeSummation tree(0, n_summands);
+        tree.distribute(numbers[i]);
+        expected.push_back(tree.accumulate(0));
+    }
+
+    EXPECT_EQ(tiny.accumulate(0), 6.0);
+
+    vector<double> results(numbers.size());
+    vector<std::thread> threads;
+    for (size_t i = 0; i < numbers.size(); i++) {
+        threads.emplace_back([&, i] () {
+            vector<int> n_summands { static_cast<int>(numbers[i].size()) };
+            BinaryTreeSummation tree(0, n_summands);
+            tree.distribute(numbers[i]);
+
+            for (int repetition = 0; repetition < 20; repetition++) {
+                results[i] = tree.accumulate(0);
+            }
+        });
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    for (size_t i = 0; i < numbers.size(); i++) {
+        EXPECT_EQ(results[i], expected[i]);
+    }
+}
+
+TEST(BinaryTreeTests, ProgressThreadHandOff) {
+    std::atomic<bool> handedOff(false);
+    std::atomic<int> calls(0);
+    std::atomic<int> callsOutsideHandOff(0);
+
+    ProgressThread progress([&] () {
+        if (!handedOff.load()) callsOutsideHandOff++;
+        calls++;
+    });
+
+    for (int i = 0; i < 100; i++) {
+        handedOff = true;
+        progress.handOff();
+        while (i % 10 == 0 && calls.load() == 0) {
+            std::this_thread::yield();
+        }
+        progress.reclaim();
+        handedOff = false;
+
+        // Nothing may be called once the communication has been reclaimed
+        const int callsAfterReclaim = calls.load();
+        std::this_thread::yield();
+        EXPECT_EQ(calls.load(), callsAfterReclaim);
+    }
+
+    EXPECT_GT(calls.load(), 0);
+    EXPECT_EQ(progress.steps(), calls.load());
+    EXPECT_EQ(callsOutsideHandOff.load(), 0);
+}
+
+TEST(BinaryTreeTests, ScanEqualToPrefixTrees) {
+    std::mt19937 gen(8);
+    std::uniform_real_distribution<> value_distrib(-1e10, 1e10);
+
+    const int n = 5'000;
+    vector<int> n_summands { n };
+    vector<double> numbers(n);
+    for (auto &x : numbers) {
+        x = value_distrib(gen);
+    }
+
+    BinaryTreeSummation tree(0, n_summands);
+    tree.distribute(numbers);
+    const vector<double> inclusive = tree.scan(true);
+    const vector<double> exclusive = tree.scan(false);
+
+    ASSERT_EQ(inclusive.size(), n);
+    EXPECT_EQ(exclusive[0], 0.0);
+    EXPECT_EQ(inclusive.back(), tree.replayPlan());
+    EXPECT_EQ(tree.rankPrefix(false), 0.0);
+    EXPECT_EQ(tree.rankPrefix(true), inclusive.back());
+
+    for (const int length : { 1, 2, 3, 7, 8, 100, 1023, 1024, 1025, 4999 }) {
+        vector<int> n_prefix { length };
+        vector<double> prefix(numbers.begin(), numbers.begin() + length);
+        BinaryTreeSummation prefixTree(0, n_prefix);
+        prefixTree.distribute(prefix);
+
+        const double expected = prefixTree.replayPlan();
+        EXPECT_EQ(inclusive[length - 1], expected) << "length = " << length;
+        EXPECT_EQ(exclusive[length], expected) << "length = " << length;
+    }
+}
+
+TEST(BinaryTreeTests, SegmentsEqualToSeparateTrees) {
+    std::mt19937 gen(9);
+    std::uniform_real_distribution<> value_distrib(-1e10, 1e10);
+
+    const int n = 20'000;
+    vector<int> n_summands { n };
+    vector<double> numbers(n);
+    for (auto &x : numbers) {
+        x = value_distrib(gen);
+    }
+
+    BinaryTreeSummation tree(0, n_summands);
+    tree.distribute(numbers);
+
+    const vector<uint64_t> boundaries { 0, 1, 1, 1000, 1024, 3333, 12000, 20000 };
+    const SegmentSums sums = tree.accumulate_segments(boundaries);
+
+    ASSERT_EQ(sums.segments.size(), boundaries.size() - 1);
+    EXPECT_EQ(sums.total, tree.replayPlan());
+
+    for (size_t i = 0; i + 1 < boundaries.size(); i++) {
+        vector<int> n_segment { static_cast<int>(boundaries[i + 1] - boundaries[i]) };
+        if (n_segment[0] == 0) {
+            EXPECT_EQ(sums.segments[i], 0.0);
+            continue;
+        }
+
+        vector<double> segment(numbers.begin() + boundaries[i], numbers.begin() + boundaries[i + 1]);
+        BinaryTreeSummation segmentTree(0, n_segment);
+        segmentTree.distribute(segment);
+        EXPECT_EQ(sums.segments[i], segmentTree.replayPlan()) << "segment = " << i;
+    }
+
+    EXPECT_THROW(tree.accumulate_segments({ 0, 20001 }), std::logic_error);
+    EXPECT_THROW(tree.accumulate_segments({ 5, 3 }), std::logic_error);
+}
+
+/* Same bits, except that NaN may differ in sign and payload */
+static bool same_bits(const double a, const double b) {
+    return (std::isnan(a) && std::isnan(b)) || memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+static bool same_bits(const LogSumExpValue a, const LogSumExpValue b) {
+    return same_bits(a.max, b.max) && same_bits(a.sum, b.sum);
+}
+
+template <typename Operator>
+static void expect_kernel_equal_to_combine(const vector<double> &numbers) {
+    const uint64_t pairs = numbers.size() / 2;
+    vector<typename Operator::value_type> leaves(pairs);
+    Operator::reduce_leaves(numbers.data(), leaves.data(), pairs);
+
+    vector<typename Operator::value_type> values(pairs / 2);
+    Operator::reduce_pairs(leaves.data(), values.data(), pairs / 2);
+
+    for (uint64_t i = 0; i < pairs / 2; i++) {
+        const auto left = Operator::combine(Operator::leaf(numbers[4 * i]), Operator::leaf(numbers[4 * i + 1]));
+        const auto right = Operator::combine(Operator::leaf(numbers[4 * i + 2]), Operator::leaf(numbers[4 * i + 3]));
+        const auto expected = Operator::combine(left, right);
+
+        EXPECT_TRUE(same_bits(values[i], expected)) << Operator::name << " i = " << i;
+    }
+}
+
+TEST(BinaryTreeTests, OperatorKernelsEqualToCombine) {
+    std::mt19937 gen(10);
+    std::uniform_real_distribution<> value_distrib(-800.0, 800.0);
+    std::uniform_int_distribution<> special_distrib(0, 15);
+    const double specials[] = { 0.0, -0.0, INFINITY, -INFINITY, NAN, 1.0, -1.0 };
+
+    vector<double> numbers(4 * 1003);
+    for (auto &x : numbers) {
+        const int special = special_distrib(gen);
+        x = (special < 7) ? specials[special] : value_distrib(gen);
+    }
+
+    expect_kernel_equal_to_combine<SumOperator>(numbers);
+    expect_kernel_equal_to_combine<ProductOperator>(numbers);
+    expect_kernel_equal_to_combine<MinOperator>(numbers);
+    expect_kernel_equal_to_combine<MaxOperator>(numbers);
+    expect_kernel_equal_to_combine<LogSumExpOperator>(numbers);
+
+    for (double x = -708.0; x <= 0.0; x += 0.0137) {
+        EXPECT_NEAR(LogSumExpOperator::exp(x) / std::exp(x), 1.0, 1e-15) << "x = " << x;
+    }
+    EXPECT_EQ(LogSumExpOperator::exp(0.0), 1.0);
+    EXPECT_EQ(LogSumExpOperator::exp(-INFINITY), 0.0);
+    EXPECT_TRUE(std::isnan(LogSumExpOperator::exp(NAN)));
+}
+
+TEST(BinaryTreeTests, TreeReductionOperators) {
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<> n_distrib(1, 100'000);
+
+    for (int i = 0; i < 5; i++) {
+        const int n = n_distrib(gen);
+        vector<int> n_summands { n };
+
+        // Log-likelihoods whose exponentials underflow
+        std::uniform_real_distribution<> value_distrib(-1500.0, -1000.0);
+        vector<double> numbers(n);
+        for (auto &x : numbers) {
+            x = value_distrib(gen);
+        }
+
+        BinaryTreeSummation tree(0, n_summands);
+        tree.distribute(numbers);
+        TreeReduction<SumOperator> sum(0, n_summands);
+        sum.distribute(numbers);
+        EXPECT_EQ(sum.replayPlan(), tree.replayPlan()) << "n = " << n;
+
+        TreeReduction<MinOperator> min(0, n_summands);
+        min.distribute(numbers);
+        EXPECT_EQ(min.replayPlan(), *std::min_element(numbers.begin(), numbers.end()));
+
+        TreeReduction<MaxOperator> max(0, n_summands);
+        max.distribute(numbers);
+        const double largest = *std::max_element(numbers.begin(), numbers.end());
+        EXPECT_EQ(max.replayPlan(), largest);
+
+        long double scaledSum = 0.0;
+        for (const double x : numbers) {
+            scaledSum += std::exp(static_cast<long double>(x - largest));
+        }
+        TreeReduction<LogSumExpOperator> logSumExp(0, n_summands);
+        logSumExp.distribute(numbers);
+        EXPECT_NEAR(logSumExp.replayPlan(), largest + std::log(scaledSum), 1e-9) << "n = " << n;
+
+        std::uniform_real_distribution<> factor_distrib(0.999, 1.001);
+        long double product = 1.0;
+        for (auto &x : numbers) {
+            x = factor_distrib(gen);
+            product *= x;
+        }
+        TreeReduction<ProductOperator> multiply(0, n_summands);
+        multiply.distribute(numbers);
+        EXPECT_NEAR(multiply.replayPlan() / product, 1.0, 1e-10) << "n = " << n;
+    }
+}
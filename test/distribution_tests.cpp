@@ -8,3 +8,12 @@ TEST(DistributionTests, RoundingUp) {
     EXPECT_EQ(Distribution::roundUp(1), 2);
     EXPECT_EQ(Distribution::roundUp(2), 4);
 }
+
+TEST(DistributionTests, ThreadsReduceComputationScore) {
+    Distribution d = Distribution::even(1 << 20, 4);
+    const double singleThreaded = d.score();
+
+    d.threadsPerRank = 4;
+    EXPECT_LT(d.score(), singleThreaded);
+    EXPECT_EQ(d.rankIntersectionCount(), Distribution::even(1 << 20, 4).rankIntersectionCount());
+}
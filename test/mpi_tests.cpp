@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <gtest/gtest.h>
+#include <mpi.h>
+#include <vector>
+#include "strategies/binary_tree.hpp"
+#include "strategies/multi_column_tree.hpp"
+
+using std::vector;
+
+/* Tests that run on any number of ranks, see the mpi_tests targets in CMakeLists.txt. All ranks draw
+ * the same random numbers, so every rank knows the whole input and can compare its results with a
+ * reference computed on a single rank */
+
+static int worldRank() {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    return rank;
+}
+
+static int worldSize() {
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    return size;
+}
+
+/* Spread n summands unevenly across the ranks, every rank gets at least one */
+static vector<int> unevenDistribution(const int n, std::mt19937 &gen) {
+    const int size = worldSize();
+    vector<int> n_summands(size, 1);
+
+    std::uniform_int_distribution<> rank_distrib(0, size - 1);
+    for (int i = size; i < n; i++) {
+        n_summands[rank_distrib(gen)]++;
+    }
+
+    return n_summands;
+}
+
+TEST(MPITests, MultiColumnEqualToSingleColumns) {
+    std::mt19937 gen(6);
+    std::uniform_real_distribution<> value_distrib(-1e10, 1e10);
+
+    for (const int columns : { 1, 2, 3, 4, 5, 8 }) {
+        for (const int n : { worldSize(), 100, 20'000 }) {
+            vector<int> n_summands = unevenDistribution(n, gen);
+            vector<double> rows(static_cast<size_t>(n) * columns);
+            for (auto &x : rows) {
+                x = value_distrib(gen);
+            }
+
+            MultiColumnTreeSummation multi(worldRank(), n_summands, columns);
+            multi.distribute(rows);
+
+            const uint64_t firstRow = std::accumulate(n_summands.begin(), n_summands.begin() + worldRank(), 0UL);
+            const vector<double> localRows = multi.getSummands();
+            EXPECT_TRUE(std::equal(localRows.begin(), localRows.end(), rows.begin() + firstRow * columns));
+
+            const vector<double> sums = multi.accumulate();
+            ASSERT_EQ(sums.size(), columns);
+
+            // Every column on its own, with the same distribution
+            for (int k = 0; k < columns; k++) {
+                vector<double> column(n);
+                for (int j = 0; j < n; j++) {
+                    column[j] = rows[static_cast<size_t>(j) * columns + k];
+                }
+
+                BinaryTreeSummation tree(worldRank(), n_summands);
+                tree.distribute(column);
+                EXPECT_EQ(sums[k], tree.accumulate()) << "n = " << n << " columns = " << columns << " k = " << k;
+            }
+        }
+    }
+}
+
+TEST(MPITests, MultiColumnConcurrentWithTree) {
+    std::mt19937 gen(21);
+    std::uniform_real_distribution<> value_distrib(-1e10, 1e10);
+
+    const int n = 5'000;
+    const int columns = 3;
+    for (const TransportMode transport : { TransportMode::ISEND, TransportMode::PERSISTENT }) {
+        vector<int> n_summands = unevenDistribution(n, gen);
+        vector<double> rows(static_cast<size_t>(n) * columns);
+        for (auto &x : rows) {
+            x = value_distrib(gen);
+        }
+        vector<double> column(n);
+        for (int j = 0; j < n; j++) {
+            column[j] = rows[static_cast<size_t>(j) * columns];
+        }
+
+        BinaryTreeSummation tree(worldRank(), n_summands, MPI_COMM_WORLD, transport);
+        tree.distribute(column);
+        MultiColumnTreeSummation multi(worldRank(), n_summands, columns, MPI_COMM_WORLD);
+        multi.distribute(rows);
+
+        const double expected = tree.accumulate();
+        const vector<double> expectedColumns = multi.accumulate();
+
+        // The messages of both reductions are in flight on the same communicator at the same time
+        std::unique_ptr<AccumulationRequest> request = tree.iaccumulate();
+        const vector<double> sums = multi.accumulate();
+        EXPECT_EQ(request->wait(), expected);
+        EXPECT_EQ(sums, expectedColumns);
+        EXPECT_EQ(sums[0], expected);
+    }
+}
+
+/* Every transport, schedule and finalization must produce the bits of a single rank */
+template <typename Operator> static void expectOperatorEqualToSingleRank(vector<double> &numbers,
+        vector<int> &n_summands) {
+    const int n = numbers.size();
+    vector<int> n_single { n };
+    TreeReduction<Operator> single(0, n_single, MPI_COMM_SELF);
+    single.distribute(numbers);
+    const double expected = single.accumulate();
+
+    for (const TransportMode transport : { TransportMode::ISEND, TransportMode::PERSISTENT, TransportMode::SHARED,
+            TransportMode::RMA, TransportMode::NEIGHBORHOOD }) {
+        for (const Finalization finalization : { Finalization::BROADCAST, Finalization::BUTTERFLY }) {
+            TreeReduction<Operator> tree(worldRank(), n_summands, MPI_COMM_WORLD, transport, finalization);
+            tree.distribute(numbers);
+            EXPECT_EQ(tree.accumulate(), expected) << Operator::name << " n = " << n;
+
+            // The neighborhood transport always computes the subtrees round by round
+            if (transport != TransportMode::NEIGHBORHOOD) {
+                tree.setScheduling(Scheduling::DATAFLOW);
+            }
+            tree.setThreads(2);
+            EXPECT_EQ(tree.accumulate(), expected) << Operator::name << " n = " << n;
+            EXPECT_EQ(tree.iaccumulate()->wait(), expected) << Operator::name << " n = " << n;
+
+            const double toLast = tree.accumulate_to(worldSize() - 1);
+            if (worldRank() == worldSize() - 1) {
+                EXPECT_EQ(toLast, expected) << Operator::name << " n = " << n;
+            }
+        }
+    }
+}
+
+TEST(MPITests, OperatorsEqualToSingleRank) {
+    std::mt19937 gen(25);
+    std::uniform_real_distribution<> value_distrib(-1e2, 1e2);
+    std::uniform_real_distribution<> factor_distrib(0.5, 2.0);
+
+    for (const int n : { worldSize(), 100, 20'000 }) {
+        vector<int> n_summands = unevenDistribution(n, gen);
+        vector<double> numbers(n);
+        vector<double> factors(n);
+        for (int i = 0; i < n; i++) {
+            numbers[i] = value_distrib(gen);
+            factors[i] = factor_distrib(gen);
+        }
+
+        expectOperatorEqualToSingleRank<MinOperator>(numbers, n_summands);
+        expectOperatorEqualToSingleRank<MaxOperator>(numbers, n_summands);
+        expectOperatorEqualToSingleRank<LogSumExpOperator>(numbers, n_summands);
+        expectOperatorEqualToSingleRank<ProductOperator>(factors, n_summands);
+    }
+}
+
+TEST(MPITests, AllreduceEqualToTreePerElement) {
+    std::mt19937 gen(22);
+    std::uniform_real_distribution<> value_distrib(-1e10, 1e10);
+
+    // Vectors that are empty, shorter than the cluster, unevenly sliced and spread over several chunks
+    for (const int columns : { 0, 1, worldSize() - 1, worldSize() + 1, 37, 700 }) {
+        for (const int n : { worldSize(), 100 }) {
+            const vector<int> n_rows = unevenDistribution(n, gen);
+            vector<double> rows(static_cast<size_t>(n) * columns);
+            for (auto &x : rows) {
+                x = value_distrib(gen);
+            }
+
+            const uint64_t firstRow = std::accumulate(n_rows.begin(), n_rows.begin() + worldRank(), 0UL);
+            vector<double> result(columns);
+            MultiColumnTreeSummation::allreduce(rows.data() + firstRow * columns, n_rows[worldRank()], columns,
+                    result.data());
+
+            // The same reduction with all rows on a single rank
+            vector<double> single(columns);
+            MultiColumnTreeSummation::allreduce(rows.data(), n, columns, single.data(), MPI_COMM_SELF);
+            EXPECT_EQ(result, single) << "n = " << n << " columns = " << columns;
+
+            for (int k = 0; k < columns; k++) {
+                vector<int> n_summands = n_rows;
+                vector<double> column(n);
+                for (int j = 0; j < n; j++) {
+                    column[j] = rows[static_cast<size_t>(j) * columns + k];
+                }
+
+                BinaryTreeSummation tree(worldRank(), n_summands);
+                tree.distribute(column);
+                EXPECT_EQ(result[k], tree.accumulate()) << "n = " << n << " columns = " << columns << " k = " << k;
+            }
+
+            // Ranks without any vectors still receive the result
+            vector<double> lastRankOnly(columns);
+            const bool last = worldRank() == worldSize() - 1;
+            MultiColumnTreeSummation::allreduce(rows.data(), last ? n : 0, columns, lastRankOnly.data());
+            EXPECT_EQ(lastRankOnly, single) << "n = " << n << " columns = " << columns;
+        }
+    }
+}
+
+TEST(MPITests, ScanEqualToSingleRank) {
+    std::mt19937 gen(23);
+    std::uniform_real_distribution<> value_distrib(-1e10, 1e10);
+
+    for (const int n : { worldSize(), 100, 5'000 }) {
+        vector<int> n_summands = unevenDistribution(n, gen);
+        vector<double> numbers(n);
+        for (auto &x : numbers) {
+            x = value_distrib(gen);
+        }
+
+        vector<int> n_single { n };
+        BinaryTreeSummation single(0, n_single, MPI_COMM_SELF);
+        single.distribute(numbers);
+        const vector<double> inclusive = single.scan(true);
+        const vector<double> exclusive = single.scan(false);
+
+        BinaryTreeSummation tree(worldRank(), n_summands);
+        tree.distribute(numbers);
+        const vector<double> localInclusive = tree.scan(true);
+        const vector<double> localExclusive = tree.scan(false);
+
+        const uint64_t first = std::accumulate(n_summands.begin(), n_summands.begin() + worldRank(), 0UL);
+        const uint64_t last = first + n_summands[worldRank()] - 1;
+        ASSERT_EQ(localInclusive.size(), n_summands[worldRank()]);
+        ASSERT_EQ(localExclusive.size(), n_summands[worldRank()]);
+        EXPECT_TRUE(std::equal(localInclusive.begin(), localInclusive.end(), inclusive.begin() + first))
+            << "n = " << n;
+        EXPECT_TRUE(std::equal(localExclusive.begin(), localExclusive.end(), exclusive.begin() + first))
+            << "n = " << n;
+
+        EXPECT_EQ(tree.rankPrefix(false), exclusive[first]) << "n = " << n;
+        EXPECT_EQ(tree.rankPrefix(true), inclusive[last]) << "n = " << n;
+    }
+}
+
+TEST(MPITests, SegmentsEqualToSingleRank) {
+    std::mt19937 gen(24);
+    std::uniform_real_distribution<> value_distrib(-1e10, 1e10);
+
+    for (const int n : { worldSize(), 1'000, 20'000 }) {
+        vector<int> n_summands = unevenDistribution(n, gen);
+        vector<double> numbers(n);
+        for (auto &x : numbers) {
+            x = value_distrib(gen);
+        }
+
+        // Segments that are empty, shorter than a rank or span several of them
+        std::uniform_int_distribution<uint64_t> boundary_distrib(0, n);
+        vector<uint64_t> boundaries { 0, 0, 1, static_cast<uint64_t>(n) };
+        for (int i = 0; i < 8; i++) {
+            boundaries.push_back(boundary_distrib(gen));
+        }
+        std::sort(boundaries.begin(), boundaries.end());
+
+        vector<int> n_single { n };
+        BinaryTreeSummation single(0, n_single, MPI_COMM_SELF);
+        single.distribute(numbers);
+        const SegmentSums expected = single.accumulate_segments(boundaries);
+
+        BinaryTreeSummation tree(worldRank(), n_summands);
+        tree.distribute(numbers);
+        const SegmentSums sums = tree.accumulate_segments(boundaries);
+
+        EXPECT_EQ(sums.segments, expected.segments) << "n = " << n;
+        EXPECT_EQ(sums.total, expected.total) << "n = " << n;
+    }
+}
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+    ::testing::InitGoogleTest(&argc, argv);
+
+    // Only the first rank reports, failures on other ranks are still counted below
+    if (worldRank() != 0) {
+        ::testing::TestEventListeners &listeners = ::testing::UnitTest::GetInstance()->listeners();
+        delete listeners.Release(listeners.default_result_printer());
+    }
+
+    int failed = RUN_ALL_TESTS();
+    MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+    MPI_Finalize();
+    return failed;
+}
@@ -34,8 +34,8 @@ def run_with_mpi(number_of_ranks, datafile_path, mode):
 
     return calculated_sum, sum_bytes
 
-def check_reproducibility(datafile, mode, reproducibilityExpected):
-    ranks_to_test = range(1, multiprocessing.cpu_count())
+def check_reproducibility(datafile, mode, reproducibilityExpected, min_ranks=1):
+    ranks_to_test = range(min_ranks, multiprocessing.cpu_count())
     results = [run_with_mpi(ranks, datafile, mode) for ranks in ranks_to_test]
     allEqual = reduce(lambda a, b: a and b, [results[0][1] == x[1] for x in results]) # compare sum bytes
 
@@ -65,6 +65,46 @@ if __name__ == "__main__":
         #    retcode = -1
         if not check_reproducibility(datafile, "--tree", True):
             retcode = -1
+        if not check_reproducibility(datafile, "--tree --threads 2", True):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --schedule dataflow", True):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --schedule dataflow --transport persistent", True):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --send-schedule critical-path", True):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --progress-thread", True):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --operator logsumexp", True):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --operator max", True):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --operator max --transport shared --schedule dataflow", True):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --operator logsumexp --transport rma --finalize butterfly", True):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --operator min --transport neighborhood --reduce-to 1 -r 20", True, min_ranks=2):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --transport shared", True):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --transport rma", True):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --transport neighborhood", True):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --finalize butterfly", True):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --finalize butterfly --reduce-to 1", True, min_ranks=2):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --reduce-to 1", True, min_ranks=2):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --schedule dataflow --reduce-to 1 -r 20", True, min_ranks=2):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --transport shared --reduce-to 1 -r 20", True, min_ranks=2):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --transport rma --reduce-to 1 -r 20", True, min_ranks=2):
+            retcode = -1
+        if not check_reproducibility(datafile, "--tree --transport shared --finalize butterfly --reduce-to 1 -r 20", True, min_ranks=2):
+            retcode = -1
         #if not check_reproducibility(datafile, "--reproblas", True):
         #    retcode = -1
         check_reproducibility(datafile, "--kahan", False)